@@ -0,0 +1,63 @@
+#include "crc32.h"
+#include <string.h>
+
+static uint32_t crc_table[8][256];
+static bool crc_table_ready = false;
+
+static void BuildTable() {
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t c = i;
+        for (int k = 0; k < 8; k++) {
+            c = (c & 1) ? (0xEDB88320 ^ (c >> 1)) : (c >> 1);
+        }
+        crc_table[0][i] = c;
+    }
+
+    // Each further table advances the previous one by one zero byte
+    for (uint32_t i = 0; i < 256; i++) {
+        for (int t = 1; t < 8; t++) {
+            uint32_t prev = crc_table[t - 1][i];
+            crc_table[t][i] = crc_table[0][prev & 0xFF] ^ (prev >> 8);
+        }
+    }
+
+    crc_table_ready = true;
+}
+
+uint32_t Crc32(const uint8_t* data, size_t len, uint32_t crc) {
+    if (!crc_table_ready) {
+        BuildTable();
+    }
+
+    crc = ~crc;
+
+    // Byte-wise until the pointer is 4-byte aligned
+    while (len && (reinterpret_cast<uintptr_t>(data) & 3)) {
+        crc = crc_table[0][(crc ^ *data++) & 0xFF] ^ (crc >> 8);
+        len--;
+    }
+
+    // Eight bytes per iteration (little-endian, which covers both the Xbox and x86 hosts)
+    while (len >= 8) {
+        uint32_t one, two;
+        memcpy(&one, data, 4);
+        memcpy(&two, data + 4, 4);
+        one ^= crc;
+        crc = crc_table[7][one & 0xFF] ^
+              crc_table[6][(one >> 8) & 0xFF] ^
+              crc_table[5][(one >> 16) & 0xFF] ^
+              crc_table[4][one >> 24] ^
+              crc_table[3][two & 0xFF] ^
+              crc_table[2][(two >> 8) & 0xFF] ^
+              crc_table[1][(two >> 16) & 0xFF] ^
+              crc_table[0][two >> 24];
+        data += 8;
+        len -= 8;
+    }
+
+    while (len--) {
+        crc = crc_table[0][(crc ^ *data++) & 0xFF] ^ (crc >> 8);
+    }
+
+    return ~crc;
+}
@@ -0,0 +1,13 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// CRC-32 (IEEE 802.3, reflected), slicing-by-8.
+// Pass the previous result as crc to continue a running checksum.
+uint32_t Crc32(const uint8_t* data, size_t len, uint32_t crc = 0);
+
+inline uint32_t Crc32(const std::vector<uint8_t>& data, uint32_t crc = 0) {
+    return Crc32(data.data(), data.size(), crc);
+}
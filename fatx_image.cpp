@@ -0,0 +1,347 @@
+#include "fatx_image.h"
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+// Retail layout, used when there is no partition table
+#define RETAIL_PARTITION1_OFFSET 0xABE80000ULL
+#define RETAIL_PARTITION1_SIZE 0x1312D6000ULL
+#define RETAIL_PARTITION6_OFFSET 0x1DD156000ULL
+// Stock kernels stop at LBA28, modified ones put Partition7 beyond it
+#define LBA28_LIMIT (0x0FFFFFFFULL * XBOX_SECTOR_SIZE)
+
+#define FATX_FAT_OFFSET 0x1000
+#define FATX_FAT_ALIGN 0x1000
+#define FATX_RESERVED_CLUSTERS 1
+#define FATX_FAT16_MAX_CLUSTERS 0xFFF5
+
+#define FATX_FAT_PAGE_SIZE 0x10000
+
+FatxImage::FatxImage() : fd(-1), image_size(0), has_table(false) {
+    memset(&table, 0, sizeof(table));
+}
+
+FatxImage::~FatxImage() {
+    Close();
+}
+
+bool FatxImage::Open(const std::string& filepath) {
+    Close();
+
+    fd = open(filepath.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        Close();
+        return false;
+    }
+    image_size = st.st_size;
+
+    // Directory walks and cluster chains jump between the FAT and scattered
+    // clusters, so large readahead would mostly fetch data that is never used
+    posix_fadvise(fd, 0, 0, POSIX_FADV_RANDOM);
+
+    has_table = Read(0, &table, sizeof(table)) &&
+                memcmp(table.magic, XBOX_PARTITION_MAGIC, sizeof(table.magic)) == 0;
+    return true;
+}
+
+void FatxImage::Close() {
+    if (fd >= 0) {
+        close(fd);
+        fd = -1;
+    }
+    image_size = 0;
+    has_table = false;
+}
+
+bool FatxImage::GetPartition(int number, uint64_t& offset, uint64_t& size) {
+    if (fd < 0 || number < 1 || number > XBOX_PARTITION_COUNT) {
+        return false;
+    }
+
+    if (has_table) {
+        const XBOX_PARTITION_ENTRY& entry = table.entries[number - 1];
+        if (!(entry.flags & XBOX_PARTITION_IN_USE)) {
+            return false;
+        }
+        offset = (uint64_t)entry.lba_start * XBOX_SECTOR_SIZE;
+        size = (uint64_t)entry.lba_size * XBOX_SECTOR_SIZE;
+    } else if (number == 1) {
+        offset = RETAIL_PARTITION1_OFFSET;
+        size = RETAIL_PARTITION1_SIZE;
+    } else if (number == 6 || number == 7) {
+        // These run to the end of the drive; without a table the image length is
+        // the only hint, so a truncated dump of an untabled drive will not parse
+        offset = number == 6 ? RETAIL_PARTITION6_OFFSET : LBA28_LIMIT;
+        uint64_t end = number == 6 && image_size > LBA28_LIMIT ? LBA28_LIMIT : image_size;
+        if (end <= offset) {
+            return false;
+        }
+        size = end - offset;
+    } else {
+        return false;
+    }
+
+    // The size stays nominal even for truncated dumps, the FAT geometry depends
+    // on it; Read() refuses anything past the end of the image
+    return offset < image_size;
+}
+
+bool FatxImage::Read(uint64_t offset, void* dst, size_t len) {
+    if (fd < 0 || offset > image_size || len > image_size - offset) {
+        return false;
+    }
+
+    uint8_t* out = static_cast<uint8_t*>(dst);
+    while (len) {
+        ssize_t got = pread(fd, out, len, offset);
+        if (got <= 0) {
+            return false;
+        }
+        out += got;
+        offset += got;
+        len -= got;
+    }
+    return true;
+}
+
+FatxVolume::FatxVolume()
+    : image(nullptr), partition_offset(0), partition_size(0), cluster_size(0),
+      cluster_count(0), root_cluster(0), fat16(false), fat_offset(0), data_offset(0) {}
+
+bool FatxVolume::Open(FatxImage& img, int partition) {
+    image = &img;
+    fat_pages.clear();
+    chains.clear();
+
+    if (!image->GetPartition(partition, partition_offset, partition_size) ||
+        partition_size < FATX_SUPERBLOCK_SIZE) {
+        return false;
+    }
+
+    FATX_SUPERBLOCK superblock;
+    if (!image->Read(partition_offset, &superblock, sizeof(superblock)) ||
+        superblock.magic != FATX_MAGIC || superblock.sectors_per_cluster == 0) {
+        return false;
+    }
+
+    cluster_size = superblock.sectors_per_cluster * XBOX_SECTOR_SIZE;
+    root_cluster = superblock.root_cluster;
+
+    // One FAT entry per cluster plus the reserved first entry, padded to 4 KB
+    cluster_count = (uint32_t)(partition_size / cluster_size) + FATX_RESERVED_CLUSTERS;
+    fat16 = cluster_count < FATX_FAT16_MAX_CLUSTERS;
+
+    uint64_t fat_size = (uint64_t)cluster_count * (fat16 ? 2 : 4);
+    fat_size = (fat_size + FATX_FAT_ALIGN - 1) & ~(uint64_t)(FATX_FAT_ALIGN - 1);
+
+    fat_offset = partition_offset + FATX_FAT_OFFSET;
+    data_offset = fat_offset + fat_size;
+    return data_offset <= partition_offset + partition_size;
+}
+
+bool FatxVolume::GetNextCluster(uint32_t cluster, uint32_t& next) {
+    uint32_t entry_size = fat16 ? 2 : 4;
+    uint64_t entry_offset = (uint64_t)cluster * entry_size;
+    uint32_t page_index = (uint32_t)(entry_offset / FATX_FAT_PAGE_SIZE);
+
+    auto page = fat_pages.find(page_index);
+    if (page == fat_pages.end()) {
+        uint64_t page_offset = (uint64_t)page_index * FATX_FAT_PAGE_SIZE;
+        uint64_t fat_size = data_offset - fat_offset;
+        size_t page_size = FATX_FAT_PAGE_SIZE;
+
+        // A truncated dump may end inside the FAT
+        if (fat_offset + fat_size > image->GetSize()) {
+            fat_size = image->GetSize() > fat_offset ? image->GetSize() - fat_offset : 0;
+        }
+        if (page_offset >= fat_size) {
+            return false;
+        }
+        if (page_size > fat_size - page_offset) {
+            page_size = fat_size - page_offset;
+        }
+
+        std::vector<uint8_t> data(page_size);
+        if (!image->Read(fat_offset + page_offset, data.data(), page_size)) {
+            return false;
+        }
+        page = fat_pages.emplace(page_index, std::move(data)).first;
+    }
+
+    size_t in_page = entry_offset % FATX_FAT_PAGE_SIZE;
+    if (in_page + entry_size > page->second.size()) {
+        return false;
+    }
+
+    if (fat16) {
+        uint16_t value;
+        memcpy(&value, page->second.data() + in_page, 2);
+        // Widen the special values so callers only deal with one range
+        next = value >= 0xFFF0 ? 0xFFFF0000 | value : value;
+    } else {
+        memcpy(&next, page->second.data() + in_page, 4);
+    }
+    return true;
+}
+
+const std::vector<FatxRun>* FatxVolume::GetChain(uint32_t first_cluster) {
+    auto cached = chains.find(first_cluster);
+    if (cached != chains.end()) {
+        return &cached->second;
+    }
+
+    std::vector<FatxRun> runs;
+    uint32_t cluster = first_cluster;
+    uint32_t length = 0;
+
+    while (cluster >= FATX_RESERVED_CLUSTERS && cluster < cluster_count) {
+        // A chain longer than the volume has clusters is a loop
+        if (++length > cluster_count) {
+            return nullptr;
+        }
+
+        if (!runs.empty() && runs.back().first_cluster + runs.back().count == cluster) {
+            runs.back().count++;
+        } else {
+            runs.push_back({ cluster, 1 });
+        }
+
+        uint32_t next;
+        if (!GetNextCluster(cluster, next)) {
+            return nullptr;
+        }
+        cluster = next;
+    }
+
+    // Anything but a proper end of chain marker means a damaged FAT
+    if (cluster < 0xFFFFFFF8) {
+        return nullptr;
+    }
+
+    return &chains.emplace(first_cluster, std::move(runs)).first->second;
+}
+
+bool FatxVolume::ReadChain(const std::vector<FatxRun>& runs, uint64_t offset, void* dst, size_t len) {
+    uint8_t* out = static_cast<uint8_t*>(dst);
+
+    for (const auto& run : runs) {
+        if (!len) break;
+
+        uint64_t run_size = (uint64_t)run.count * cluster_size;
+        if (offset >= run_size) {
+            offset -= run_size;
+            continue;
+        }
+
+        size_t chunk = len;
+        if (chunk > run_size - offset) {
+            chunk = run_size - offset;
+        }
+
+        uint64_t disk_offset = data_offset +
+                               (uint64_t)(run.first_cluster - FATX_RESERVED_CLUSTERS) * cluster_size +
+                               offset;
+        if (!image->Read(disk_offset, out, chunk)) {
+            return false;
+        }
+
+        out += chunk;
+        len -= chunk;
+        offset = 0;
+    }
+
+    return len == 0;
+}
+
+bool FatxVolume::ReadFile(const FatxEntry& entry, uint64_t offset, void* dst, size_t len) {
+    if (offset > entry.size || len > entry.size - offset) {
+        return false;
+    }
+    if (!len) {
+        return true;
+    }
+
+    const std::vector<FatxRun>* runs = GetChain(entry.first_cluster);
+    return runs && ReadChain(*runs, offset, dst, len);
+}
+
+bool FatxVolume::CheckFileSize(const FatxEntry& entry) {
+    if (!entry.size) {
+        return true;
+    }
+
+    const std::vector<FatxRun>* chain = GetChain(entry.first_cluster);
+    if (!chain) {
+        return false;
+    }
+
+    uint64_t chain_size = 0;
+    for (const auto& run : *chain) {
+        chain_size += (uint64_t)run.count * cluster_size;
+    }
+    return entry.size <= chain_size;
+}
+
+bool FatxVolume::GetRunCount(const FatxEntry& entry, size_t& runs) {
+    // Empty files have no chain at all
+    if (!entry.size) {
+        runs = 0;
+        return true;
+    }
+
+    const std::vector<FatxRun>* chain = GetChain(entry.first_cluster);
+    if (!chain) {
+        return false;
+    }
+
+    runs = chain->size();
+    return true;
+}
+
+FatxDirIterator::FatxDirIterator(FatxVolume& vol, uint32_t first_cluster)
+    : volume(vol), position(0), cluster_base(0), done(false) {
+    chain = volume.GetChain(first_cluster);
+    if (!chain) {
+        done = true;
+    }
+}
+
+bool FatxDirIterator::Next(FatxEntry& entry) {
+    while (!done) {
+        // Directories have no size, they end with the chain or a marker entry
+        if (cluster.empty() || position >= cluster_base + cluster.size()) {
+            cluster_base = position;
+            cluster.resize(volume.cluster_size);
+            if (!volume.ReadChain(*chain, cluster_base, cluster.data(), cluster.size())) {
+                done = true;
+                break;
+            }
+        }
+
+        FATX_DIRENT dirent;
+        memcpy(&dirent, cluster.data() + (position - cluster_base), sizeof(dirent));
+        position += sizeof(dirent);
+
+        if (dirent.name_len == FATX_DIRENT_END || dirent.name_len == FATX_DIRENT_UNUSED) {
+            done = true;
+            break;
+        }
+        if (dirent.name_len == FATX_DIRENT_DELETED || dirent.name_len > FATX_NAME_LEN) {
+            continue;
+        }
+
+        entry.name.assign(dirent.name, dirent.name_len);
+        entry.attributes = dirent.attributes;
+        entry.first_cluster = dirent.first_cluster;
+        entry.size = dirent.file_size;
+        return true;
+    }
+
+    return false;
+}
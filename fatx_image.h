@@ -0,0 +1,152 @@
+#pragma once
+
+// Read-only access to raw Xbox HDD dumps, for running iconator offline
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+#define FATX_MAGIC 0x58544146  // "FATX"
+#define FATX_SUPERBLOCK_SIZE 0x1000
+#define FATX_NAME_LEN 42
+#define FATX_ATTR_DIRECTORY 0x10
+#define FATX_DIRENT_END 0x00
+#define FATX_DIRENT_UNUSED 0xFF
+#define FATX_DIRENT_DELETED 0xE5
+
+#define XBOX_SECTOR_SIZE 512
+#define XBOX_PARTITION_MAGIC "****PARTINFO****"
+#define XBOX_PARTITION_IN_USE 0x80000000
+#define XBOX_PARTITION_COUNT 14
+
+#pragma pack(push, 1)
+struct FATX_SUPERBLOCK {
+    uint32_t magic;                // "FATX"
+    uint32_t volume_id;            // Volume serial number
+    uint32_t sectors_per_cluster;  // Cluster size in 512 byte sectors
+    uint32_t root_cluster;         // First cluster of the root directory
+    uint16_t unknown;
+};
+
+struct FATX_DIRENT {
+    uint8_t  name_len;             // Name length, or one of the FATX_DIRENT_* markers
+    uint8_t  attributes;           // FAT style attributes
+    char     name[FATX_NAME_LEN];  // Not null terminated
+    uint32_t first_cluster;        // First cluster of the data
+    uint32_t file_size;            // Size in bytes, 0 for directories
+    uint16_t modified_time;
+    uint16_t modified_date;
+    uint16_t created_time;
+    uint16_t created_date;
+    uint16_t accessed_time;
+    uint16_t accessed_date;
+};
+
+// Partition table written by XBPartitioner and friends, in sector 0
+struct XBOX_PARTITION_ENTRY {
+    char     name[16];
+    uint32_t flags;                // XBOX_PARTITION_IN_USE
+    uint32_t lba_start;
+    uint32_t lba_size;
+    uint32_t reserved;
+};
+
+struct XBOX_PARTITION_TABLE {
+    char     magic[16];            // "****PARTINFO****"
+    uint8_t  reserved[32];
+    XBOX_PARTITION_ENTRY entries[XBOX_PARTITION_COUNT];  // Partition1 first
+};
+#pragma pack(pop)
+
+struct FatxEntry {
+    std::string name;
+    uint8_t attributes;
+    uint32_t first_cluster;
+    uint32_t size;
+
+    bool IsDirectory() const { return (attributes & FATX_ATTR_DIRECTORY) != 0; }
+};
+
+// The raw disk image and its partition layout
+class FatxImage {
+public:
+    FatxImage();
+    ~FatxImage();
+
+    bool Open(const std::string& filepath);
+    void Close();
+
+    // Partition numbers match \Device\Harddisk0\PartitionN. The size is the
+    // nominal one and may extend past the end of a truncated dump
+    bool GetPartition(int number, uint64_t& offset, uint64_t& size);
+    bool Read(uint64_t offset, void* dst, size_t len);
+    uint64_t GetSize() const { return image_size; }
+
+private:
+    int fd;
+    uint64_t image_size;
+    bool has_table;
+    XBOX_PARTITION_TABLE table;
+};
+
+// A run of physically contiguous clusters
+struct FatxRun {
+    uint32_t first_cluster;
+    uint32_t count;
+};
+
+// One FATX partition inside an image. FAT pages and resolved cluster chains
+// are cached, so repeated lookups cost no I/O and file data is read as a few
+// large ranged reads, one per contiguous run.
+class FatxVolume {
+public:
+    FatxVolume();
+
+    bool Open(FatxImage& image, int partition);
+    uint32_t GetRootCluster() const { return root_cluster; }
+    bool ReadFile(const FatxEntry& entry, uint64_t offset, void* dst, size_t len);
+
+    // The size fits the cluster chain; a damaged entry could claim up to 4 GB
+    bool CheckFileSize(const FatxEntry& entry);
+
+    // Number of contiguous runs the file's data is split into, 1 if unfragmented
+    bool GetRunCount(const FatxEntry& entry, size_t& runs);
+
+private:
+    friend class FatxDirIterator;
+
+    FatxImage* image;
+    uint64_t partition_offset;
+    uint64_t partition_size;
+    uint32_t cluster_size;
+    uint32_t cluster_count;
+    uint32_t root_cluster;
+    bool fat16;
+    uint64_t fat_offset;
+    uint64_t data_offset;
+
+    std::map<uint32_t, std::vector<uint8_t>> fat_pages;
+    std::map<uint32_t, std::vector<FatxRun>> chains;
+
+    bool GetNextCluster(uint32_t cluster, uint32_t& next);
+    const std::vector<FatxRun>* GetChain(uint32_t first_cluster);
+    bool ReadChain(const std::vector<FatxRun>& runs, uint64_t offset, void* dst, size_t len);
+};
+
+// Walks the entries of one directory, skipping deleted ones
+class FatxDirIterator {
+public:
+    FatxDirIterator(FatxVolume& volume, uint32_t first_cluster);
+
+    bool Next(FatxEntry& entry);
+
+private:
+    FatxVolume& volume;
+    const std::vector<FatxRun>* chain;
+    std::vector<uint8_t> cluster;
+    uint64_t position;      // Byte offset within the directory
+    uint64_t cluster_base;  // Directory offset of the buffered cluster
+    bool done;
+};
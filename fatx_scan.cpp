@@ -0,0 +1,231 @@
+/*
+* Offline iconator: scans a raw Xbox HDD image and writes the same
+* UDATA/INI output the Xbox app would, without mounting anything.
+*/
+
+#include "fatx_image.h"
+#include "iconator.h"
+#include "platform.h"
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <string>
+#include <vector>
+
+struct PartitionMapping {
+    int partition;
+    char driveLetter;
+};
+
+// Same partitions as the Harddisk0 entries of the Xbox app's DRIVE_MAPPINGS
+static const PartitionMapping PARTITION_MAPPINGS[] = {
+    {1, 'E'},
+    {6, 'F'},
+    {7, 'G'},
+};
+
+// Nested title folders rarely go deeper than this, it also stops directory loops
+#define MAX_SCAN_DEPTH 8
+
+void FindDefaultXBE(FatxVolume& volume, uint32_t dirCluster, const std::string& path, int depth,
+                    std::vector<GameInfo>& games, const Options& options, VerifyStats& verifyStats) {
+    if (depth > MAX_SCAN_DEPTH) {
+        return;
+    }
+
+    FatxDirIterator it(volume, dirCluster);
+    FatxEntry entry;
+    while (it.Next(entry)) {
+        // Paths keep the Xbox form so Icons.ini comes out identical
+        std::string current_path = path + "\\" + entry.name;
+
+        if (entry.IsDirectory()) {
+            FindDefaultXBE(volume, entry.first_cluster, current_path, depth + 1,
+                           games, options, verifyStats);
+        } else if (IsDefaultXBE(entry.name.c_str())) {
+            if (!volume.CheckFileSize(entry)) {
+                printf("Size of %s does not match its clusters, skipping\n", current_path.c_str());
+                continue;
+            }
+
+            XBEParser parser;
+            bool loaded = parser.LoadXBE(entry.size,
+                [&volume, &entry](uint64_t offset, void* dst, size_t len) {
+                    return volume.ReadFile(entry, offset, dst, len);
+                });
+            if (loaded) {
+                ProcessXBE(parser, current_path, options, verifyStats, games);
+            }
+        }
+    }
+}
+
+struct FragmentationStats {
+    size_t files;
+    size_t fragmented;  // Files in more than one run
+    size_t runs;
+    size_t unreadable;
+};
+
+// Prints the cluster run count of every file below a directory, to compare
+// how well different writers keep UDATA contiguous on a dump from the console
+void ReportFragmentation(FatxVolume& volume, uint32_t dirCluster, const std::string& path, int depth,
+                         FragmentationStats& stats) {
+    if (depth > MAX_SCAN_DEPTH) {
+        return;
+    }
+
+    FatxDirIterator it(volume, dirCluster);
+    FatxEntry entry;
+    while (it.Next(entry)) {
+        std::string current_path = path + "\\" + entry.name;
+
+        if (entry.IsDirectory()) {
+            ReportFragmentation(volume, entry.first_cluster, current_path, depth + 1, stats);
+            continue;
+        }
+
+        size_t runs;
+        if (!volume.GetRunCount(entry, runs)) {
+            printf("   ? %10u %s\n", entry.size, current_path.c_str());
+            stats.unreadable++;
+            continue;
+        }
+
+        printf("%4zu %10u %s\n", runs, entry.size, current_path.c_str());
+        stats.files++;
+        stats.runs += runs;
+        if (runs > 1) {
+            stats.fragmented++;
+        }
+    }
+}
+
+static int RunFragmentationReport(FatxImage& image) {
+    FatxVolume volume;
+    if (!volume.Open(image, 1)) {
+        printf("Image has no readable E: partition\n");
+        return 2;
+    }
+
+    FatxDirIterator root(volume, volume.GetRootCluster());
+    FatxEntry entry;
+    while (root.Next(entry)) {
+        if (!entry.IsDirectory() || strcasecmp(entry.name.c_str(), "UDATA") != 0) continue;
+
+        FragmentationStats stats = {0};
+        printf("Runs       Size Path\n");
+        ReportFragmentation(volume, entry.first_cluster, "E:\\" + entry.name, 0, stats);
+
+        // Average runs per file with two decimals, in integer math
+        size_t avg100 = stats.files ? stats.runs * 100 / stats.files : 0;
+        printf("\n%zu files, %zu fragmented, %zu.%02zu runs per file, %zu unreadable\n",
+               stats.files, stats.fragmented, avg100 / 100, avg100 % 100, stats.unreadable);
+        return 0;
+    }
+
+    printf("No UDATA directory on E:\n");
+    return 2;
+}
+
+static void Usage(const char* argv0) {
+    printf("Usage: %s [options] <hdd image> <output dir>\n"
+           "       %s --fragmentation <hdd image>\n"
+           "  --refresh        Rewrite existing UDATA files whose content differs\n"
+           "  --verify=1|2     Check the title image (1) or all (2) section digests\n"
+           "  --atlas          Pack title images into UDATA\\TitleAtlas*.xbx\n"
+           "  --icons <dir>    Fallback icons by title ID (UIX-Lite Icons folder)\n"
+           "Output goes to <output dir>/E, copy its contents to E:\\ on the console.\n"
+           "--fragmentation lists the cluster runs of every file in E:\\UDATA.\n",
+           argv0, argv0);
+}
+
+int main(int argc, char** argv) {
+    Options options;
+
+    std::vector<std::string> positional;
+    bool fragmentation = false;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--fragmentation") == 0) {
+            fragmentation = true;
+        } else if (strcmp(argv[i], "--refresh") == 0) {
+            options.refresh = true;
+        } else if (strcmp(argv[i], "--verify=1") == 0) {
+            options.verify = VERIFY_TITLE_IMAGE;
+        } else if (strcmp(argv[i], "--verify=2") == 0) {
+            options.verify = VERIFY_ALL;
+        } else if (strcmp(argv[i], "--atlas") == 0) {
+            options.atlas = true;
+        } else if (strcmp(argv[i], "--icons") == 0 && i + 1 < argc) {
+            options.icons_path = argv[++i];
+        } else if (argv[i][0] == '-') {
+            Usage(argv[0]);
+            return 1;
+        } else {
+            positional.push_back(argv[i]);
+        }
+    }
+
+    if (positional.size() != (fragmentation ? 1u : 2u)) {
+        Usage(argv[0]);
+        return 1;
+    }
+
+    FatxImage image;
+    if (!image.Open(positional[0])) {
+        printf("Failed to open image %s\n", positional[0].c_str());
+        return 2;
+    }
+
+    if (fragmentation) {
+        return RunFragmentationReport(image);
+    }
+
+    std::vector<GameInfo> titles;
+    VerifyStats verifyStats = {0};
+    bool haveE = false;
+
+    for (const auto& mapping : PARTITION_MAPPINGS) {
+        FatxVolume volume;
+        if (!volume.Open(image, mapping.partition)) {
+            printf("No FATX volume on Partition%d (%c:)\n", mapping.partition, mapping.driveLetter);
+            continue;
+        }
+        if (mapping.driveLetter == 'E') {
+            haveE = true;
+        }
+
+        // Only the well known title folders in the root are searched
+        FatxDirIterator root(volume, volume.GetRootCluster());
+        FatxEntry entry;
+        while (root.Next(entry)) {
+            if (!entry.IsDirectory()) continue;
+
+            for (size_t i = 0; i < SCAN_PATH_COUNT; i++) {
+                if (strcasecmp(entry.name.c_str(), SCAN_PATHS[i]) == 0) {
+                    std::string scanPath = std::string(1, mapping.driveLetter) + ":\\" + entry.name;
+                    FindDefaultXBE(volume, entry.first_cluster, scanPath, 0,
+                                   titles, options, verifyStats);
+                }
+            }
+        }
+    }
+
+    if (!haveE) {
+        printf("Image has no readable E: partition\n");
+        return 2;
+    }
+
+    if (options.verify != VERIFY_NONE) {
+        PrintVerifyStats(verifyStats);
+    }
+
+    printf("\nFound %zu titles\n", titles.size());
+
+    MakeDirectory(positional[1]);
+    options.output_root = JoinPath(positional[1], "E");
+    MakeDirectory(options.output_root);
+
+    SaveOutputs(titles, options);
+    return 0;
+}
@@ -0,0 +1,530 @@
+#include "iconator.h"
+#include "crc32.h"
+#include "xbx_image.h"
+#include "title_atlas.h"
+#include "output_writer.h"
+#include "platform.h"
+#include <stdio.h>
+#include <ctype.h>
+#include <string.h>
+#include <algorithm>
+#include <map>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+
+const char* const SCAN_PATHS[] = {
+    "Apps",
+    "Dashboards",
+    "Games",
+    "Emulators",
+    "Homebrew"
+};
+const size_t SCAN_PATH_COUNT = sizeof(SCAN_PATHS) / sizeof(SCAN_PATHS[0]);
+
+// Maps output path to the CRC32 and size last written there,
+// so unchanged files can be skipped without reading them back
+struct DigestEntry {
+    uint32_t crc;
+    uint32_t size;
+    bool used;  // Checked or written this run; only these are saved
+};
+static std::map<std::string, DigestEntry> digestCache;
+
+// Output root of the current run; cache keys are relative to it
+static std::string digestRoot;
+
+// "UDATA\4D530004\TitleImage.xbx" whether written as E:\... on the console or
+// out/E/... by the offline scanner, so one cache works for both
+static std::string DigestKey(const std::string& path) {
+    std::string key = path;
+    if (key.size() > digestRoot.size() && key.compare(0, digestRoot.size(), digestRoot) == 0) {
+        key = key.substr(digestRoot.size() + 1);
+    }
+    std::replace(key.begin(), key.end(), '/', '\\');
+    return key;
+}
+
+// Every output file goes through here
+static OutputWriter outputWriter;
+
+// Strips spaces, tabs and the \r left by CRLF line endings
+static std::string Trim(const std::string& text) {
+    size_t first = text.find_first_not_of(" \t\r");
+    if (first == std::string::npos) return "";
+    size_t last = text.find_last_not_of(" \t\r");
+    return text.substr(first, last - first + 1);
+}
+
+void LoadOptions(const std::string& path, Options& options) {
+    std::ifstream f(path);
+    if (!f) return;
+
+    std::string line;
+    while (std::getline(f, line)) {
+        size_t eq = line.find('=');
+        if (eq == std::string::npos) continue;
+
+        std::string key = Trim(line.substr(0, eq));
+        std::string value = Trim(line.substr(eq + 1));
+        if (key == "Refresh") {
+            options.refresh = (value == "1");
+        } else if (key == "Verify") {
+            // 1 = title image section only, 2 = all sections
+            if (value == "1") {
+                options.verify = VERIFY_TITLE_IMAGE;
+            } else if (value == "2") {
+                options.verify = VERIFY_ALL;
+            }
+        } else if (key == "Atlas") {
+            options.atlas = (value == "1");
+        } else if (key == "Benchmark") {
+            options.benchmark = (value == "1");
+        }
+    }
+}
+
+bool IsDefaultXBE(const char* name) {
+    static const char defaultName[] = "default.xbe";
+    size_t i = 0;
+    for (; defaultName[i]; i++) {
+        if (tolower((unsigned char)name[i]) != defaultName[i]) {
+            return false;
+        }
+    }
+    return name[i] == '\0';
+}
+
+bool ProcessXBE(XBEParser& parser, const std::string& xbe_path, const Options& options,
+                VerifyStats& verifyStats, std::vector<GameInfo>& games) {
+    GameInfo game;
+    game.xbe_path = xbe_path;
+
+    if (options.verify != VERIFY_NONE) {
+        size_t bytesHashed = 0;
+        uint64_t start = GetUs();
+        XBEVerifyResult result = parser.VerifySections(options.verify == VERIFY_ALL, bytesHashed,
+                                                      game.title_image);
+        verifyStats.us += GetUs() - start;
+        verifyStats.bytes += bytesHashed;
+        verifyStats.titles++;
+
+        // Corrupt or half-copied XBE, keep it out of the outputs
+        if (result == XBE_VERIFY_MISMATCH) {
+            verifyStats.failed++;
+            LogPrint("Section digest mismatch, skipping %s\n", xbe_path.c_str());
+            return false;
+        }
+
+        if (result == XBE_VERIFY_NO_SECTION) {
+            verifyStats.unverified++;
+            LogPrint("Nothing to verify in %s\n", xbe_path.c_str());
+        }
+    }
+
+    if (!parser.ExtractTitleID(game.title_id) || 
+        !parser.ExtractTitle(game.title)) {
+        return false;
+    }
+
+    // Verify=1 already read the title image. If extraction fails, its not fatal
+    if (game.title_image.empty() && !parser.ExtractTitleImage(game.title_image)) {
+        // Keep the small grayscale logo in case the icons directory has nothing
+        // either; the XBX is only built if it ends up being used
+        game.logo_bitmap.resize(LOGO_WIDTH * LOGO_HEIGHT);
+        if (!parser.ExtractLogoBitmap(game.logo_bitmap.data(), game.logo_bitmap.size())) {
+            game.logo_bitmap.clear();
+        }
+    }
+
+    games.push_back(game);
+    LogPrint("Found game: %s (Title ID: %08X)\n", 
+             game.title.c_str(), 
+             game.title_id);
+    LogPrint("Title image: %zu bytes\n",
+             game.title_image.size());
+    return true;
+}
+
+void PrintVerifyStats(const VerifyStats& verifyStats) {
+    // Bytes per microsecond is MB/s; scaled by 100 for two decimals in integer math
+    uint64_t mbPerSec100 = verifyStats.us ? verifyStats.bytes * 100 / verifyStats.us : 0;
+    LogPrint("Verified %zu titles (%zu bad, %zu unverified), %llu bytes in %llu us, %lu.%02lu MB/s\n",
+             verifyStats.titles, verifyStats.failed, verifyStats.unverified,
+             (unsigned long long)verifyStats.bytes, (unsigned long long)verifyStats.us,
+             (unsigned long)(mbPerSec100 / 100), (unsigned long)(mbPerSec100 % 100));
+}
+
+static std::string GetDirectoryName(const std::string& fullPath) {
+    // Find the last backslash
+    size_t lastSlash = fullPath.find_last_of('\\');
+    if (lastSlash == std::string::npos) return "";
+    
+    // Find the second-to-last backslash
+    size_t secondLastSlash = fullPath.find_last_of('\\', lastSlash - 1);
+    if (secondLastSlash == std::string::npos) return "";
+    
+    // Extract the directory name between the two last backslashes
+    return fullPath.substr(secondLastSlash + 1, lastSlash - secondLastSlash - 1);
+}
+
+// Queues a small output file whose only outcome worth reporting is failure
+static void QueueOutput(const std::string& path, const std::string& content) {
+    outputWriter.Queue(path, content, [](const std::string& path, bool success) {
+        if (!success) {
+            LogPrint("Failed writing %s\n", path.c_str());
+        }
+    });
+}
+
+static void SaveIconsIni(const std::vector<GameInfo>& games, std::string path) {
+    std::ostringstream f;
+    
+    f << "[default]\n";
+    for (const auto& game : games) {
+        std::string dirName = GetDirectoryName(game.xbe_path);
+        if (!dirName.empty()) {
+            f << dirName << "=" << std::hex << std::uppercase 
+              << std::setfill('0') << std::setw(8) 
+              << game.title_id << "\n";
+        }
+    }
+
+    QueueOutput(path, f.str());
+}
+
+static void SaveTitleNamesIni(const std::vector<GameInfo>& games, std::string path) {
+    std::ostringstream f;
+    
+    f << "[default]\n";
+    for (const auto& game : games) {
+        std::string dirName = GetDirectoryName(game.xbe_path);
+        if (!dirName.empty()) {
+            f << dirName << "=" << game.title << "\n";
+        }
+    }
+
+    QueueOutput(path, f.str());
+}
+
+static void LoadDigestCache(const std::string& path) {
+    std::ifstream f(path);
+    if (!f) return;
+
+    // Format: <crc> <size> <path>, one file per line
+    std::string line;
+    while (std::getline(f, line)) {
+        char filePath[MAX_PATH];
+        unsigned long crc, size;
+        if (sscanf(line.c_str(), "%08lX %lu %259[^\n]", &crc, &size, filePath) == 3) {
+            digestCache[filePath] = { (uint32_t)crc, (uint32_t)size, false };
+        }
+    }
+}
+
+static void SaveDigestCache(const std::string& path) {
+    std::string cache;
+    char line[MAX_PATH + 32];
+    for (const auto& it : digestCache) {
+        // Files of removed titles or deleted behind our back drop out here
+        if (!it.second.used) continue;
+
+        snprintf(line, sizeof(line), "%08lX %lu %s\n",
+                 (unsigned long)it.second.crc, (unsigned long)it.second.size, it.first.c_str());
+        cache += line;
+    }
+
+    QueueOutput(path, cache);
+}
+
+// Reads a whole file into data, leaving it empty on failure
+static bool ReadFileData(const std::string& path, std::vector<uint8_t>& data) {
+    data.clear();
+
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (!file.is_open()) {
+        return false;
+    }
+
+    auto fileSize = file.tellg();
+    file.seekg(0, std::ios::beg);
+
+    data.resize(fileSize);
+    if (!file.read(reinterpret_cast<char*>(data.data()), fileSize)) {
+        data.clear();
+        return false;
+    }
+    return true;
+}
+
+enum WriteResult {
+    WRITE_SKIPPED,
+    WRITE_UNCHANGED,  // Refresh found the existing file identical to content
+    WRITE_DONE,
+    WRITE_FAILED,
+    WRITE_QUEUED      // Outcome is counted and logged when the writer is flushed
+};
+
+// Writes content to path unless the file already exists. In refresh mode an
+// existing file is only rewritten when its CRC32 differs from the new content,
+// otherwise WRITE_UNCHANGED tells the caller the file already holds content.
+// Small files can be queued, stats must then outlive the next Flush.
+static WriteResult WriteIfChanged(const std::string& path, const std::vector<uint8_t>& content,
+                                  bool refresh, UpdateStats& stats, bool queue = false) {
+    std::string key = DigestKey(path);
+    std::ifstream existing(path, std::ios::binary | std::ios::ate);
+    if (existing.is_open()) {
+        if (!refresh) {
+            // The file is still there, so whatever we knew about it stays valid
+            auto cached = digestCache.find(key);
+            if (cached != digestCache.end()) {
+                cached->second.used = true;
+            }
+            stats.skipped++;
+            return WRITE_SKIPPED;
+        }
+
+        stats.checked++;
+        uint32_t newCrc = Crc32(content);
+        size_t existingSize = existing.tellg();
+
+        if (existingSize == content.size()) {
+            auto cached = digestCache.find(key);
+            if (cached != digestCache.end()) {
+                // Trust the stored digest for files we wrote ourselves
+                if (cached->second.crc == newCrc && cached->second.size == content.size()) {
+                    cached->second.used = true;
+                    stats.skipped++;
+                    return WRITE_UNCHANGED;
+                }
+            } else {
+                std::vector<uint8_t> existingData(existingSize);
+                existing.seekg(0, std::ios::beg);
+                if (existing.read(reinterpret_cast<char*>(existingData.data()), existingSize) &&
+                    Crc32(existingData) == newCrc) {
+                    digestCache[key] = { newCrc, (uint32_t)content.size(), true };
+                    stats.skipped++;
+                    return WRITE_UNCHANGED;
+                }
+            }
+        }
+        existing.close();
+    }
+
+    // Whatever was there is about to be replaced
+    digestCache.erase(key);
+
+    DigestEntry digest = { Crc32(content), (uint32_t)content.size(), true };
+    if (queue) {
+        outputWriter.Queue(path, content, [key, digest, &stats](const std::string& path, bool success) {
+            if (success) {
+                digestCache[key] = digest;
+                stats.rewritten++;
+                LogPrint("Saved %s\n", path.c_str());
+            } else {
+                stats.failed++;
+                LogPrint("Failed writing %s\n", path.c_str());
+            }
+        });
+        return WRITE_QUEUED;
+    }
+
+    if (!outputWriter.Write(path, content)) {
+        stats.failed++;
+        return WRITE_FAILED;
+    }
+
+    digestCache[key] = digest;
+    stats.rewritten++;
+    return WRITE_DONE;
+}
+
+// Returns "<root>\UDATA\XXXXXXXX", creating it
+static std::string MakeTitleDirectory(const Options& options, uint32_t title_id) {
+    char titleDir[16];
+    snprintf(titleDir, sizeof(titleDir), "%08X", title_id);
+
+    std::string dirPath = JoinPath(JoinPath(options.output_root, "UDATA"), titleDir);
+    MakeDirectory(dirPath);
+    return dirPath;
+}
+
+static void SaveTitleMeta(const std::vector<GameInfo>& games, const Options& options, UpdateStats& stats) {
+    for (const auto& game : games) {
+        if (game.title.empty()) continue;
+        
+        std::string metaFilePath = JoinPath(MakeTitleDirectory(options, game.title_id), "TitleMeta.xbx");
+
+        std::string meta = "TitleName=" + game.title + "\n";
+        std::vector<uint8_t> metaData(meta.begin(), meta.end());
+
+        // Queue the title metadata, a few bytes each; written and reported on flush
+        WriteResult result = WriteIfChanged(metaFilePath, metaData, options.refresh, stats, true);
+        if (result == WRITE_SKIPPED || result == WRITE_UNCHANGED) {
+            LogPrint("Title metadata up to date for %s, skipping...\n", game.title.c_str());
+        }
+    }
+}
+
+static void CopyTitleImages(std::vector<GameInfo>& games, const Options& options, UpdateStats& stats) {
+    for (auto& game : games) {
+        std::vector<uint8_t> titleImageData = game.title_image;
+        if (titleImageData.empty() && !options.icons_path.empty()) {
+            // Read from local file instead
+            char iconName[16];
+            snprintf(iconName, sizeof(iconName), "%08x", game.title_id);
+            std::string sourceIconPath = JoinPath(options.icons_path, iconName);
+
+            ReadFileData(sourceIconPath, titleImageData);
+        }
+
+        if (titleImageData.empty()) {
+            // Last resort, the publisher logo decoded during the scan
+            if (game.logo_bitmap.empty() ||
+                !BuildXBXFromGrayscale(game.logo_bitmap.data(), LOGO_WIDTH, LOGO_HEIGHT, titleImageData)) {
+                LogPrint("No title image, icon or logo for %s\n", game.title.c_str());
+                continue;
+            }
+        }
+        
+        std::string imageFilePath = JoinPath(MakeTitleDirectory(options, game.title_id), "TitleImage.xbx");
+
+        // Write the title image data
+        WriteResult result = WriteIfChanged(imageFilePath, titleImageData, options.refresh, stats);
+
+        // The atlas packs whichever image ended up in UDATA. A skipped or failed
+        // write leaves the old file there, which may differ from the candidate,
+        // so only then is it read back, and only if the atlas will use it
+        if (result == WRITE_DONE || result == WRITE_UNCHANGED) {
+            game.title_image.swap(titleImageData);
+        } else if (options.atlas) {
+            ReadFileData(imageFilePath, game.title_image);
+        }
+
+        if (result == WRITE_DONE) {
+            LogPrint("Saved title image for %s to %s\n", 
+                     game.title.c_str(), imageFilePath.c_str());
+        } else if (result == WRITE_SKIPPED || result == WRITE_UNCHANGED) {
+            LogPrint("Title image/icon up to date for %s, skipping...\n", game.title.c_str());
+        } else {
+            LogPrint("Failed writing title image to %s\n", imageFilePath.c_str());
+        }
+    }
+}
+
+// Removes TitleAtlas<first_page>.xbx and every page after it
+static void RemoveAtlasPages(const std::string& udataPath, size_t first_page) {
+    char pageName[32];
+    for (size_t page = first_page; ; page++) {
+        snprintf(pageName, sizeof(pageName), "TitleAtlas%u.xbx", (unsigned)page);
+        std::string pagePath = JoinPath(udataPath, pageName);
+        if (!RemoveFile(pagePath)) break;
+        digestCache.erase(DigestKey(pagePath));
+    }
+}
+
+// With the atlas turned off, an old atlas would no longer match UDATA
+static void RemoveTitleAtlas(const Options& options) {
+    std::string udataPath = JoinPath(options.output_root, "UDATA");
+    std::string indexPath = JoinPath(udataPath, "TitleAtlas.ini");
+
+    RemoveAtlasPages(udataPath, 0);
+    if (RemoveFile(indexPath)) {
+        digestCache.erase(DigestKey(indexPath));
+        LogPrint("Removed title image atlas\n");
+    }
+}
+
+static void SaveTitleAtlas(const std::vector<GameInfo>& games, const Options& options, UpdateStats& stats) {
+    std::string udataPath = JoinPath(options.output_root, "UDATA");
+    std::string indexPath = JoinPath(udataPath, "TitleAtlas.ini");
+
+    TitleAtlas atlas;
+    std::vector<uint8_t> previousIndex;
+    if (ReadFileData(indexPath, previousIndex)) {
+        atlas.LoadIndex(std::string(previousIndex.begin(), previousIndex.end()));
+    }
+
+    for (const auto& game : games) {
+        if (game.title_image.empty()) continue;
+
+        if (!atlas.AddImage(game.title_id, game.title_image)) {
+            LogPrint("Title image for %s is not a %ux%u DXT1/A8R8G8B8 texture, not in atlas\n",
+                     game.title.c_str(), XBX_IMAGE_SIZE, XBX_IMAGE_SIZE);
+        }
+    }
+    atlas.AssignSlots();
+
+    char pageName[32];
+
+    // Pages and index are always compared, so only changed pages get rewritten
+    size_t pageCount = atlas.GetPageCount();
+    for (size_t page = 0; page < pageCount; page++) {
+        std::vector<uint8_t> pageData;
+        atlas.BuildPage(page, pageData);
+
+        snprintf(pageName, sizeof(pageName), "TitleAtlas%u.xbx", (unsigned)page);
+        std::string pagePath = JoinPath(udataPath, pageName);
+        if (WriteIfChanged(pagePath, pageData, true, stats) == WRITE_FAILED) {
+            LogPrint("Failed writing atlas page %s\n", pagePath.c_str());
+        }
+    }
+
+    // Drop pages left over from a larger library
+    RemoveAtlasPages(udataPath, pageCount);
+
+    std::string index;
+    atlas.BuildIndex(index);
+    std::vector<uint8_t> indexData(index.begin(), index.end());
+    if (WriteIfChanged(indexPath, indexData, true, stats) == WRITE_FAILED) {
+        LogPrint("Failed writing atlas index\n");
+    }
+
+    LogPrint("Atlas: %zu titles on %zu pages\n", atlas.GetTileCount(), pageCount);
+}
+
+static void PrintUpdateStats(const char* stage, const UpdateStats& stats) {
+    LogPrint("%s: %zu checked, %zu skipped, %zu rewritten, %zu failed\n",
+             stage, stats.checked, stats.skipped, stats.rewritten, stats.failed);
+}
+
+void SaveOutputs(std::vector<GameInfo>& games, const Options& options) {
+    UpdateStats imageStats = {0};
+    UpdateStats metaStats = {0};
+    UpdateStats atlasStats = {0};
+
+    std::string udataPath = JoinPath(options.output_root, "UDATA");
+    std::string digestCachePath = JoinPath(udataPath, "iconator.crc");
+
+    MakeDirectory(udataPath);
+    digestRoot = options.output_root;
+    LoadDigestCache(digestCachePath);
+
+    LogPrint("Copying title images...\n");
+    CopyTitleImages(games, options, imageStats);
+    PrintUpdateStats("Title images", imageStats);
+    if (options.atlas) {
+        LogPrint("Building title image atlas...\n");
+        SaveTitleAtlas(games, options, atlasStats);
+        PrintUpdateStats("Title atlas", atlasStats);
+    } else {
+        RemoveTitleAtlas(options);
+    }
+    LogPrint("Saving title metadata...\n");
+    SaveTitleMeta(games, options, metaStats);
+    outputWriter.Flush();
+    PrintUpdateStats("Title metadata", metaStats);
+
+    // The cache is saved after every UDATA write has completed
+    SaveDigestCache(digestCachePath);
+    LogPrint("Saving Icons.ini ...\n");
+    SaveIconsIni(games, JoinPath(options.output_root, "Icons.ini"));
+    LogPrint("Saving TitleNames.ini ...\n");
+    SaveTitleNamesIni(games, JoinPath(options.output_root, "TitleNames.ini"));
+    outputWriter.Flush();
+
+    LogPrint("Wrote %zu files, %llu bytes in %llu us\n",
+             outputWriter.GetFileCount(),
+             (unsigned long long)outputWriter.GetByteCount(),
+             (unsigned long long)outputWriter.GetElapsedUs());
+}
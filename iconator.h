@@ -0,0 +1,60 @@
+#pragma once
+
+// Scan and output stages shared by the Xbox app and the offline image scanner
+
+#include "xbe_parser.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+enum VerifyMode {
+    VERIFY_NONE,
+    VERIFY_TITLE_IMAGE,  // Only the $$XTIMAGE section
+    VERIFY_ALL           // Every section
+};
+
+// Runtime options, read from iconator.ini
+struct Options {
+    bool refresh = false;              // Rewrite existing UDATA files whose content differs
+    VerifyMode verify = VERIFY_NONE;   // Check section digests before accepting a title
+    bool atlas = false;                // Pack all title images into UDATA\TitleAtlas*.xbx
+    bool benchmark = false;            // Compare OutputWriter against std::ofstream
+
+    std::string output_root;           // Where Icons.ini and UDATA go, "E:" on the Xbox
+    std::string icons_path;            // Fallback icons by title ID, "Q:\Icons" on the Xbox
+};
+
+// Section digest verification totals
+struct VerifyStats {
+    size_t titles;
+    size_t failed;
+    size_t unverified;  // Nothing to check, e.g. no $$XTIMAGE with Verify=1 or no digest
+    uint64_t bytes;
+    uint64_t us;
+};
+
+// Per-file outcome counters for the UDATA writers
+struct UpdateStats {
+    size_t checked;    // Existing files that were compared
+    size_t skipped;    // Existing files left untouched
+    size_t rewritten;  // Files written (new or changed)
+    size_t failed;     // Files that could not be written
+};
+
+// Title directories searched on every drive
+extern const char* const SCAN_PATHS[];
+extern const size_t SCAN_PATH_COUNT;
+
+// Overrides the defaults with the keys present in the INI at path
+void LoadOptions(const std::string& path, Options& options);
+
+// FATX keeps the case a file was copied with, so "Default.XBE" counts too
+bool IsDefaultXBE(const char* name);
+
+// Verifies and extracts a loaded XBE, adding it to games on success
+bool ProcessXBE(XBEParser& parser, const std::string& xbe_path, const Options& options,
+                VerifyStats& verifyStats, std::vector<GameInfo>& games);
+void PrintVerifyStats(const VerifyStats& verifyStats);
+
+// Writes UDATA, the optional atlas and the INIs below options.output_root
+void SaveOutputs(std::vector<GameInfo>& games, const Options& options);
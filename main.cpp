@@ -7,6 +7,9 @@
 #include <hal/video.h>
 #include <hal/xbox.h>
 #include "xbe_parser.h"
+#include "iconator.h"
+#include "output_writer.h"
+#include "platform.h"
 #include <string>
 #include <vector>
 #include <fstream>
@@ -29,15 +32,8 @@ static const DriveMapping DRIVE_MAPPINGS[] = {
     {"\\Device\\Harddisk1\\Partition7", 'J', false},
 };
 
-static const std::string PATHS[] = {
-    "Apps",
-    "Dashboards"
-    "Games",
-    "Emulators",
-    "Homebrew"
-};
-
-void FindDefaultXBE(const std::string& path, std::vector<GameInfo>& games) {
+void FindDefaultXBE(const std::string& path, std::vector<GameInfo>& games,
+                    const Options& options, VerifyStats& verifyStats) {
     WIN32_FIND_DATA findFileData;
     HANDLE hFind;
     std::string search_path = path + "\\*\\*.*";
@@ -54,26 +50,12 @@ void FindDefaultXBE(const std::string& path, std::vector<GameInfo>& games) {
             // Skip "." and ".."
             if (strcmp(findFileData.cFileName, ".") != 0 && 
                 strcmp(findFileData.cFileName, "..") != 0) {
-                FindDefaultXBE(current_path, games);
+                FindDefaultXBE(current_path, games, options, verifyStats);
             }
-        } else if (strcmp(findFileData.cFileName, "default.xbe") == 0) {
+        } else if (IsDefaultXBE(findFileData.cFileName)) {
             XBEParser parser;
             if (parser.LoadXBE(current_path)) {
-                GameInfo game;
-                game.xbe_path = current_path;
-                
-                if (parser.ExtractTitleID(game.title_id) && 
-                    parser.ExtractTitle(game.title)) {
-                    // If Title image extraction fails, its not fatal
-                    parser.ExtractTitleImage(game.title_image);
-
-                    games.push_back(game);
-                    debugPrint("Found game: %s (Title ID: %08X)\n", 
-                             game.title.c_str(), 
-                             game.title_id);
-                    debugPrint("Title image: %zu bytes\n",
-                             game.title_image.size());
-                }
+                ProcessXBE(parser, current_path, options, verifyStats, games);
             }
         }
     } while (FindNextFile(hFind, &findFileData) != 0);
@@ -81,137 +63,58 @@ void FindDefaultXBE(const std::string& path, std::vector<GameInfo>& games) {
     FindClose(hFind);
 }
 
-std::string GetDirectoryName(const std::string& fullPath) {
-    // Find the last backslash
-    size_t lastSlash = fullPath.find_last_of('\\');
-    if (lastSlash == std::string::npos) return "";
-    
-    // Find the second-to-last backslash
-    size_t secondLastSlash = fullPath.find_last_of('\\', lastSlash - 1);
-    if (secondLastSlash == std::string::npos) return "";
-    
-    // Extract the directory name between the two last backslashes
-    return fullPath.substr(secondLastSlash + 1, lastSlash - secondLastSlash - 1);
-}
-
-void SaveIconsIni(const std::vector<GameInfo>& games, std::string path) {
-    std::ofstream f(path);
-    if (!f) return;
-    
-    f << "[default]\n";
-    for (const auto& game : games) {
-        std::string dirName = GetDirectoryName(game.xbe_path);
-        if (!dirName.empty()) {
-            f << dirName << "=" << std::hex << std::uppercase 
-              << std::setfill('0') << std::setw(8) 
-              << game.title_id << "\n";
-        }
-    }
-}
-
-void SaveTitleNamesIni(const std::vector<GameInfo>& games, std::string path) {
-    std::ofstream f(path);
-    if (!f) return;
-    
-    f << "[default]\n";
-    for (const auto& game : games) {
-        std::string dirName = GetDirectoryName(game.xbe_path);
-        if (!dirName.empty()) {
-            f << dirName << "=" << game.title << "\n";
-        }
-    }
-}
-
-void SaveTitleMeta(const std::vector<GameInfo>& games) {
-    for (const auto& game : games) {
-        if (game.title.empty()) continue;
-        
-        // Create directory path in format "E:\UDATA\XXXXXXXX\"
-        char dirPath[MAX_PATH];
-        snprintf(dirPath, sizeof(dirPath), "E:\\UDATA\\%08X", game.title_id);
-        
-        // Create the directory
-        CreateDirectory(dirPath, NULL);
-        
-        char metaFilePath[MAX_PATH];
-        snprintf(metaFilePath, sizeof(metaFilePath), "%s\\TitleMeta.xbx", dirPath);
-
-        // Check if files already exist
-        std::ifstream fMetaExists(metaFilePath);
-        if (fMetaExists && fMetaExists.good()) {
-            if (fMetaExists)
-                fMetaExists.close();
-
-            debugPrint("Title metadata already exists for %s, skipping...\n", game.title.c_str());
-            continue;
-        }
-
-        // Write the title metadatadata
-        std::ofstream f(metaFilePath);
-        if (f) {
-            f << "TitleName=" << game.title << "\n";
-            debugPrint("Saved title meta for %s to %s\n", 
-                    game.title.c_str(), metaFilePath);
-        }
-    }
-}
-
-void CopyTitleImages(const std::vector<GameInfo>& games) {
-    for (const auto& game : games) {
+// Writes every title image once through std::ofstream and once through
+// OutputWriter into a scratch directory and reports the throughput of each.
+// The writer that goes first alternates per title, and nothing is deleted
+// until both are done, so neither side gets clusters freed by the other.
+void BenchmarkWriters(const std::vector<GameInfo>& games) {
+    // Kept out of UDATA so the dashboard never sees half-written scratch files
+    const char* benchDir = "E:\\CACHE\\iconator.bench";
+    CreateDirectory("E:\\CACHE", NULL);
+    CreateDirectory(benchDir, NULL);
+
+    OutputWriter writer;
+    uint64_t bytes = 0;
+    uint64_t streamUs = 0;
+    char streamPath[MAX_PATH];
+    char writerPath[MAX_PATH];
+
+    for (size_t i = 0; i < games.size(); i++) {
+        const auto& game = games[i];
         if (game.title_image.empty()) continue;
-        
-        // Create directory path in format "E:\UDATA\XXXXXXXX\"
-        char dirPath[MAX_PATH];
-        snprintf(dirPath, sizeof(dirPath), "E:\\UDATA\\%08X", game.title_id);
-        
-        // Create the directory
-        CreateDirectory(dirPath, NULL);
-        
-        // Create full file paths
-        char imageFilePath[MAX_PATH];
-        snprintf(imageFilePath, sizeof(imageFilePath), "%s\\TitleImage.xbx", dirPath);
-
-        // Check if files already exist
-        std::ifstream fImageExists(imageFilePath);
-        if (fImageExists && fImageExists.good()) {
-            if (fImageExists)
-                fImageExists.close();
-
-            debugPrint("Title image/icon already exist for %s, skipping...\n", game.title.c_str());
-            continue;
-        }
-
-        std::vector<uint8_t> titleImageData = game.title_image;
-        if (titleImageData.empty()) {
-            // Read from local file instead
-            char sourceIconPath[MAX_PATH];
-            snprintf(dirPath, sizeof(dirPath), "Q:\\Icons\\%08x", game.title_id);
 
-            std::ifstream sourceIcon(sourceIconPath, std::ios::binary | std::ios::ate);
-            if (!sourceIcon.is_open()) {
-                debugPrint("Failed opening icon xbx from %s\n", sourceIconPath);
-                continue;
+        snprintf(streamPath, sizeof(streamPath), "%s\\%08X.s.xbx", benchDir, game.title_id);
+        snprintf(writerPath, sizeof(writerPath), "%s\\%08X.w.xbx", benchDir, game.title_id);
+
+        for (int pass = 0; pass < 2; pass++) {
+            if ((pass + i) % 2 == 0) {
+                uint64_t start = GetUs();
+                std::ofstream f(streamPath, std::ios::binary);
+                f.write(reinterpret_cast<const char*>(game.title_image.data()),
+                        game.title_image.size());
+                f.close();
+                streamUs += GetUs() - start;
+            } else {
+                writer.Write(writerPath, game.title_image);
             }
-
-            auto iconFileSize = sourceIcon.tellg();
-            sourceIcon.seekg(0, std::ios::beg);
-
-            // Read from local icon file into vec
-            titleImageData.reserve(iconFileSize);
-            titleImageData.insert(titleImageData.begin(),
-               std::istream_iterator<uint8_t>(sourceIcon),
-               std::istream_iterator<uint8_t>());
         }
+        bytes += game.title_image.size();
+    }
 
-        // Write the title image data
-        std::ofstream f(imageFilePath, std::ios::binary);
-        if (f) {
-            f.write(reinterpret_cast<const char*>(game.title_image.data()), 
-                game.title_image.size());
-            debugPrint("Saved title image for %s to %s\n", 
-                    game.title.c_str(), imageFilePath);
-        }
+    for (const auto& game : games) {
+        snprintf(streamPath, sizeof(streamPath), "%s\\%08X.s.xbx", benchDir, game.title_id);
+        snprintf(writerPath, sizeof(writerPath), "%s\\%08X.w.xbx", benchDir, game.title_id);
+        DeleteFile(streamPath);
+        DeleteFile(writerPath);
     }
+    RemoveDirectory(benchDir);
+
+    // Bytes per microsecond is MB/s, scaled by 1000 for KB/s
+    uint64_t writerUs = writer.GetElapsedUs();
+    debugPrint("Benchmark, %llu bytes: ofstream %llu us (%lu KB/s), OutputWriter %llu us (%lu KB/s)\n",
+              (unsigned long long)bytes,
+              (unsigned long long)streamUs, (unsigned long)(streamUs ? bytes * 1000 / streamUs : 0),
+              (unsigned long long)writerUs, (unsigned long)(writerUs ? bytes * 1000 / writerUs : 0));
 }
 
 bool MountHome()
@@ -232,6 +135,8 @@ bool MountHome()
 int main(void) {
     std::vector<char> vecDrives;
     std::vector<GameInfo> titles;
+    Options options;
+    VerifyStats verifyStats = {0};
     bool success = false;
 
     XVideoSetMode(640, 480, 32, REFRESH_DEFAULT);
@@ -253,6 +158,17 @@ int main(void) {
         }
     }
 
+    LoadOptions("Q:\\iconator.ini", options);
+    options.output_root = "E:";
+    options.icons_path = "Q:\\Icons";
+    if (options.refresh) {
+        debugPrint("Refresh mode: rewriting changed UDATA files\n");
+    }
+    if (options.verify != VERIFY_NONE) {
+        debugPrint("Verify mode: checking %s section digests\n",
+                  options.verify == VERIFY_ALL ? "all" : "title image");
+    }
+
     debugPrint("Enumerated drives:\n");
     for (auto& driveLetter : vecDrives) {
         debugPrint("%c:\\\n", driveLetter);
@@ -260,12 +176,16 @@ int main(void) {
 
     // Search for games in each drive
     for (auto& driveLetter : vecDrives) {
-        for (auto& path : PATHS) {
-            std::string scanPath = std::string(1, driveLetter) + ":\\" + path;
-            FindDefaultXBE(scanPath, titles);
+        for (size_t i = 0; i < SCAN_PATH_COUNT; i++) {
+            std::string scanPath = std::string(1, driveLetter) + ":\\" + SCAN_PATHS[i];
+            FindDefaultXBE(scanPath, titles, options, verifyStats);
         }
     }
 
+    if (options.verify != VERIFY_NONE) {
+        PrintVerifyStats(verifyStats);
+    }
+
     debugPrint("\nFound %zu titles:\n", titles.size());
     for (const auto& title : titles) {
         debugPrint("Path: %s\nTitle: %s\nTitle ID: %08X\n", 
@@ -276,14 +196,11 @@ int main(void) {
                   title.title_image.size());
     }
 
-    debugPrint("Copying title images...\n");
-    CopyTitleImages(titles);
-    debugPrint("Saving title metadata...\n");
-    SaveTitleMeta(titles);
-    debugPrint("Saving Icons.ini ...\n");
-    SaveIconsIni(titles, "E:\\Icons.ini");
-    debugPrint("Saving TitleNames.ini ...\n");
-    SaveTitleNamesIni(titles, "E:\\TitleNames.ini");
+    SaveOutputs(titles, options);
+
+    if (options.benchmark) {
+        BenchmarkWriters(titles);
+    }
 
     while (1) {
         Sleep(2000);
@@ -0,0 +1,152 @@
+#include "output_writer.h"
+#include "platform.h"
+#include <string.h>
+
+#ifndef NXDK
+#include <errno.h>
+#include <fcntl.h>
+#endif
+
+OutputWriter::OutputWriter() : files_written(0), bytes_written(0), elapsed_us(0) {
+    // Over-allocate so the staging buffer can start on a cluster boundary
+    buffer_alloc = new uint8_t[OUTPUT_BUFFER_SIZE + OUTPUT_CLUSTER_SIZE];
+    uintptr_t aligned = (reinterpret_cast<uintptr_t>(buffer_alloc) + OUTPUT_CLUSTER_SIZE - 1) &
+                        ~(uintptr_t)(OUTPUT_CLUSTER_SIZE - 1);
+    buffer = reinterpret_cast<uint8_t*>(aligned);
+}
+
+OutputWriter::~OutputWriter() {
+    delete[] buffer_alloc;
+}
+
+bool OutputWriter::Write(const std::string& path, const uint8_t* data, size_t size) {
+    uint64_t start = GetUs();
+    bool success = WriteChunks(path, data, size);
+    elapsed_us += GetUs() - start;
+
+    if (success) {
+        files_written++;
+        bytes_written += size;
+    }
+    return success;
+}
+
+void OutputWriter::Queue(const std::string& path, const uint8_t* data, size_t size, const WriteDone& done) {
+    if (size > OUTPUT_BUFFER_SIZE) {
+        bool success = Write(path, data, size);
+        if (done) done(path, success);
+        return;
+    }
+
+    QueuedFile file = { path, queue_data.size(), size, done };
+    queue_data.insert(queue_data.end(), data, data + size);
+    queue.push_back(file);
+
+    if (queue_data.size() >= OUTPUT_BATCH_SIZE) {
+        Flush();
+    }
+}
+
+size_t OutputWriter::Flush() {
+    // Take the batch first, callbacks may queue more files
+    std::vector<QueuedFile> files;
+    std::vector<uint8_t> data;
+    files.swap(queue);
+    data.swap(queue_data);
+
+    size_t failed = 0;
+    for (const auto& file : files) {
+        bool success = Write(file.path, data.data() + file.offset, file.size);
+        if (!success) failed++;
+        if (file.done) file.done(file.path, success);
+    }
+    return failed;
+}
+
+#ifdef NXDK
+
+bool OutputWriter::WriteChunks(const std::string& path, const uint8_t* data, size_t size) {
+    HANDLE file = CreateFile(path.c_str(), GENERIC_WRITE, 0, NULL, CREATE_ALWAYS,
+                             FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+
+    // Reserve the final size first so FATX allocates the cluster chain in one go
+    bool success = SetFilePointer(file, (LONG)size, NULL, FILE_BEGIN) != INVALID_SET_FILE_POINTER &&
+                   SetEndOfFile(file) &&
+                   SetFilePointer(file, 0, NULL, FILE_BEGIN) != INVALID_SET_FILE_POINTER;
+
+    size_t offset = 0;
+    while (success && offset < size) {
+        size_t chunk = size - offset;
+        if (chunk > OUTPUT_BUFFER_SIZE) {
+            chunk = OUTPUT_BUFFER_SIZE;
+        }
+
+        memcpy(buffer, data + offset, chunk);
+
+        DWORD written = 0;
+        success = ::WriteFile(file, buffer, (DWORD)chunk, &written, NULL) && written == chunk;
+        offset += chunk;
+    }
+
+    CloseHandle(file);
+    if (!success) {
+        RemoveFile(path);
+    }
+    return success;
+}
+
+#else
+
+bool OutputWriter::WriteChunks(const std::string& path, const uint8_t* data, size_t size) {
+    // O_DIRECT bypasses the page cache; not every filesystem supports it
+    bool direct = true;
+    int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_DIRECT, 0644);
+    if (fd < 0 && errno == EINVAL) {
+        direct = false;
+        fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    }
+    if (fd < 0) {
+        return false;
+    }
+
+    // Reserve the final size first; not fatal where unsupported
+    if (size) {
+        posix_fallocate(fd, 0, size);
+    }
+
+    bool success = true;
+    size_t offset = 0;
+    while (success && offset < size) {
+        size_t chunk = size - offset;
+        if (chunk > OUTPUT_BUFFER_SIZE) {
+            chunk = OUTPUT_BUFFER_SIZE;
+        }
+
+        memcpy(buffer, data + offset, chunk);
+
+        // Direct I/O needs whole blocks, the tail is padded and truncated below
+        size_t io_size = chunk;
+        if (direct) {
+            io_size = (chunk + OUTPUT_CLUSTER_SIZE - 1) & ~(size_t)(OUTPUT_CLUSTER_SIZE - 1);
+            memset(buffer + chunk, 0, io_size - chunk);
+        }
+
+        success = write(fd, buffer, io_size) == (ssize_t)io_size;
+        offset += chunk;
+    }
+
+    if (success && ftruncate(fd, size) != 0) {
+        success = false;
+    }
+
+    close(fd);
+    if (!success) {
+        RemoveFile(path);
+    }
+    return success;
+}
+
+#endif
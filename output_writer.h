@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+// FATX cluster size on the data partitions, also a multiple of the host block size
+#define OUTPUT_CLUSTER_SIZE 0x4000
+// Staging buffer, a whole number of clusters
+#define OUTPUT_BUFFER_SIZE (OUTPUT_CLUSTER_SIZE * 4)
+// Queued small files are flushed once this much data is pending
+#define OUTPUT_BATCH_SIZE (OUTPUT_BUFFER_SIZE * 4)
+
+// Called once per queued file when it has been written, or failed to
+typedef std::function<void(const std::string& path, bool success)> WriteDone;
+
+// Writes whole files in one go: the final size is reserved up front so the
+// filesystem can allocate a single run of clusters, then the data goes out in
+// cluster sized chunks from an aligned staging buffer that is reused across files.
+// Small files can be queued instead and go out back to back on Flush, so their
+// clusters end up next to each other rather than between the title images.
+class OutputWriter {
+public:
+    OutputWriter();
+    ~OutputWriter();
+
+    bool Write(const std::string& path, const uint8_t* data, size_t size);
+    bool Write(const std::string& path, const std::vector<uint8_t>& data) {
+        return Write(path, data.data(), data.size());
+    }
+    bool Write(const std::string& path, const std::string& text) {
+        return Write(path, reinterpret_cast<const uint8_t*>(text.data()), text.size());
+    }
+
+    // Files larger than the staging buffer are written right away
+    void Queue(const std::string& path, const uint8_t* data, size_t size, const WriteDone& done);
+    void Queue(const std::string& path, const std::vector<uint8_t>& data, const WriteDone& done) {
+        Queue(path, data.data(), data.size(), done);
+    }
+    void Queue(const std::string& path, const std::string& text, const WriteDone& done) {
+        Queue(path, reinterpret_cast<const uint8_t*>(text.data()), text.size(), done);
+    }
+
+    // Writes every queued file in order, returns how many failed
+    size_t Flush();
+
+    size_t GetFileCount() const { return files_written; }
+    uint64_t GetByteCount() const { return bytes_written; }
+    uint64_t GetElapsedUs() const { return elapsed_us; }
+
+private:
+    struct QueuedFile {
+        std::string path;
+        size_t offset;  // Into queue_data
+        size_t size;
+        WriteDone done;
+    };
+
+    uint8_t* buffer_alloc;
+    uint8_t* buffer;
+    size_t files_written;
+    uint64_t bytes_written;
+    uint64_t elapsed_us;
+
+    std::vector<QueuedFile> queue;
+    std::vector<uint8_t> queue_data;
+
+    bool WriteChunks(const std::string& path, const uint8_t* data, size_t size);
+};
@@ -0,0 +1,77 @@
+#pragma once
+
+// The few OS services the shared pipeline needs, so it builds both
+// with nxdk and on a Linux host
+
+#include <cstdint>
+#include <string>
+
+#ifdef NXDK
+#include <windows.h>
+#include <hal/debug.h>
+#include <xboxkrnl/xboxkrnl.h>
+
+#define LogPrint debugPrint
+#define PATH_SEPARATOR '\\'
+
+inline bool MakeDirectory(const std::string& path) {
+    return CreateDirectory(path.c_str(), NULL);
+}
+
+inline bool RemoveFile(const std::string& path) {
+    return DeleteFile(path.c_str());
+}
+
+inline bool RemoveEmptyDirectory(const std::string& path) {
+    return RemoveDirectory(path.c_str());
+}
+
+inline uint32_t GetMs() {
+    return GetTickCount();
+}
+
+// Tick count is too coarse for a single title; use the ACPI timer
+inline uint64_t GetUs() {
+    uint64_t freq = KeQueryPerformanceFrequency();
+    uint64_t ticks = KeQueryPerformanceCounter();
+    return (ticks / freq) * 1000000 + (ticks % freq) * 1000000 / freq;
+}
+#else
+#include <chrono>
+#include <stdio.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define LogPrint printf
+#define PATH_SEPARATOR '/'
+
+#ifndef MAX_PATH
+#define MAX_PATH 260
+#endif
+
+inline bool MakeDirectory(const std::string& path) {
+    return mkdir(path.c_str(), 0755) == 0;
+}
+
+inline bool RemoveFile(const std::string& path) {
+    return unlink(path.c_str()) == 0;
+}
+
+inline bool RemoveEmptyDirectory(const std::string& path) {
+    return rmdir(path.c_str()) == 0;
+}
+
+inline uint32_t GetMs() {
+    return (uint32_t)std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+inline uint64_t GetUs() {
+    return (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+#endif
+
+inline std::string JoinPath(const std::string& dir, const std::string& name) {
+    return dir + PATH_SEPARATOR + name;
+}
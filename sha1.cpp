@@ -0,0 +1,114 @@
+#include "sha1.h"
+#include <string.h>
+
+#define ROL(x, n) (((x) << (n)) | ((x) >> (32 - (n))))
+
+SHA1::SHA1() {
+    Reset();
+}
+
+void SHA1::Reset() {
+    state[0] = 0x67452301;
+    state[1] = 0xEFCDAB89;
+    state[2] = 0x98BADCFE;
+    state[3] = 0x10325476;
+    state[4] = 0xC3D2E1F0;
+    total_len = 0;
+    buffer_len = 0;
+}
+
+// The message schedule is kept as a rolling 16-word window
+#define SCHED(i) ((i) < 16 ? w[i] : (w[(i) & 15] = ROL(w[((i) + 13) & 15] ^ w[((i) + 8) & 15] ^ \
+                                                      w[((i) + 2) & 15] ^ w[(i) & 15], 1)))
+
+// One round step. Callers rotate the variable roles instead of shuffling
+// the working registers, which saves four moves per step.
+#define STEP(f, k, a, b, c, d, e, i) \
+    e += ROL(a, 5) + f(b, c, d) + (k) + SCHED(i); \
+    b = ROL(b, 30);
+
+#define ROUND5(f, k, i) \
+    STEP(f, k, a, b, c, d, e, (i)) \
+    STEP(f, k, e, a, b, c, d, (i) + 1) \
+    STEP(f, k, d, e, a, b, c, (i) + 2) \
+    STEP(f, k, c, d, e, a, b, (i) + 3) \
+    STEP(f, k, b, c, d, e, a, (i) + 4)
+
+#define F1(b, c, d) (d ^ (b & (c ^ d)))
+#define F2(b, c, d) (b ^ c ^ d)
+#define F3(b, c, d) ((b & c) | (d & (b | c)))
+
+void SHA1::Transform(const uint8_t* block) {
+    uint32_t w[16];
+    for (int i = 0; i < 16; i++) {
+        w[i] = (uint32_t)block[i * 4] << 24 | (uint32_t)block[i * 4 + 1] << 16 |
+               (uint32_t)block[i * 4 + 2] << 8 | (uint32_t)block[i * 4 + 3];
+    }
+
+    uint32_t a = state[0], b = state[1], c = state[2], d = state[3], e = state[4];
+
+    for (int i = 0; i < 20; i += 5) {
+        ROUND5(F1, 0x5A827999, i)
+    }
+    for (int i = 20; i < 40; i += 5) {
+        ROUND5(F2, 0x6ED9EBA1, i)
+    }
+    for (int i = 40; i < 60; i += 5) {
+        ROUND5(F3, 0x8F1BBCDC, i)
+    }
+    for (int i = 60; i < 80; i += 5) {
+        ROUND5(F2, 0xCA62C1D6, i)
+    }
+
+    state[0] += a;
+    state[1] += b;
+    state[2] += c;
+    state[3] += d;
+    state[4] += e;
+}
+
+void SHA1::Update(const uint8_t* data, size_t len) {
+    total_len += len;
+
+    // Top up a partially filled block first
+    if (buffer_len) {
+        size_t take = 64 - buffer_len;
+        if (take > len) take = len;
+        memcpy(buffer + buffer_len, data, take);
+        buffer_len += take;
+        data += take;
+        len -= take;
+
+        if (buffer_len < 64) return;
+        Transform(buffer);
+        buffer_len = 0;
+    }
+
+    // Hash whole blocks straight from the caller's memory
+    while (len >= 64) {
+        Transform(data);
+        data += 64;
+        len -= 64;
+    }
+
+    memcpy(buffer, data, len);
+    buffer_len = len;
+}
+
+void SHA1::Final(uint8_t digest[SHA1_DIGEST_LEN]) {
+    uint64_t bit_len = total_len * 8;
+
+    uint8_t pad[72] = {0x80};
+    size_t pad_len = (buffer_len < 56) ? (56 - buffer_len) : (120 - buffer_len);
+    for (int i = 0; i < 8; i++) {
+        pad[pad_len + i] = (uint8_t)(bit_len >> (56 - i * 8));
+    }
+    Update(pad, pad_len + 8);
+
+    for (int i = 0; i < 5; i++) {
+        digest[i * 4]     = (uint8_t)(state[i] >> 24);
+        digest[i * 4 + 1] = (uint8_t)(state[i] >> 16);
+        digest[i * 4 + 2] = (uint8_t)(state[i] >> 8);
+        digest[i * 4 + 3] = (uint8_t)state[i];
+    }
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#define SHA1_DIGEST_LEN 20
+
+// Incremental SHA-1, as used for XBE section digests
+class SHA1 {
+public:
+    SHA1();
+
+    void Reset();
+    void Update(const uint8_t* data, size_t len);
+    void Final(uint8_t digest[SHA1_DIGEST_LEN]);
+
+private:
+    uint32_t state[5];
+    uint64_t total_len;
+    uint8_t buffer[64];
+    size_t buffer_len;
+
+    void Transform(const uint8_t* block);
+};
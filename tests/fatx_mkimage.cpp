@@ -0,0 +1,468 @@
+/*
+* Builds small raw Xbox HDD images for `make -f Makefile.host check`, each
+* with the E:\ tree fatx_scan --verify=1 is expected to write for it.
+*
+*   fatx_mkimage <dir>
+*
+* writes <dir>/<case>.img and <dir>/<case>.expected/E for every case below.
+*/
+
+#include "crc32.h"
+#include "fatx_image.h"
+#include "platform.h"
+#include "sha1.h"
+#include "xbe_parser.h"
+#include "xbx_image.h"
+#include <stdio.h>
+#include <string.h>
+#include <map>
+#include <string>
+#include <vector>
+
+#define MB (1024ULL * 1024ULL)
+
+// Headers are mapped at the retail base address, so address translation is exercised
+#define XBE_BASE_ADDRESS 0x10000
+#define XBE_HEADERS_SIZE 0x1000
+#define XBE_CERTIFICATE_OFFSET 0x180
+#define XBE_SECTIONS_OFFSET 0x400
+#define XBE_NAMES_OFFSET 0x600
+#define XBE_LOGO_OFFSET 0x700
+
+struct TitleSpec {
+    uint32_t title_id;
+    const char* name;
+    bool title_image;  // Has a $$XTIMAGE section, otherwise only the logo
+    bool bad_digest;   // $$XTIMAGE digest does not match, --verify=1 drops it
+    bool no_digest;    // $$XTIMAGE digest left zero as homebrew does, kept unverified
+};
+
+// Expected output of one title that survives the scan
+struct ExpectedTitle {
+    std::string dir_name;  // Folder holding default.xbe, the Icons.ini key
+    uint32_t title_id;
+    std::string title;
+    std::vector<uint8_t> title_image;
+};
+
+// A DXT1 title image whose blocks differ per title
+static std::vector<uint8_t> BuildTitleImage(uint32_t seed) {
+    const uint32_t blocks = (XBX_IMAGE_SIZE / 4) * (XBX_IMAGE_SIZE / 4);
+    std::vector<uint8_t> xbx;
+    BuildXBXHeader(XBX_FORMAT_DXT1, 7, 7, blocks * DXT1_BLOCK_SIZE, xbx);
+    for (uint32_t i = 0; i < blocks * DXT1_BLOCK_SIZE; i++) {
+        xbx[XPR_HEADER_SIZE + i] = (uint8_t)(i * 3 + seed);
+    }
+    return xbx;
+}
+
+// Logo RLE with both run encodings; pixels receives the decoded bitmap
+static std::vector<uint8_t> BuildLogo(std::vector<uint8_t>& pixels) {
+    std::vector<uint8_t> rle;
+    pixels.clear();
+
+    for (uint32_t i = 0; i < 20; i++) {
+        // 8-bit run: bit 0, 3-bit length, 4-bit value
+        uint32_t len = 1 + i % 7;
+        uint32_t value = i % 16;
+        rle.push_back((uint8_t)(1 | (len << 1) | (value << 4)));
+        pixels.insert(pixels.end(), len, (uint8_t)((value << 4) | value));
+
+        // 16-bit run: bit 1, 10-bit length, 4-bit value
+        len = 40 + i;
+        value = 15 - i % 16;
+        uint16_t word = (uint16_t)(2 | (len << 2) | (value << 12));
+        rle.push_back((uint8_t)word);
+        rle.push_back((uint8_t)(word >> 8));
+        pixels.insert(pixels.end(), len, (uint8_t)((value << 4) | value));
+    }
+
+    // The parser crops to the logo size and leaves the rest black
+    pixels.resize(LOGO_WIDTH * LOGO_HEIGHT, 0);
+    return rle;
+}
+
+static std::vector<uint8_t> BuildXBE(const TitleSpec& spec, ExpectedTitle& expected) {
+    std::vector<uint8_t> logo_pixels;
+    std::vector<uint8_t> logo = BuildLogo(logo_pixels);
+    std::vector<uint8_t> image = BuildTitleImage(spec.title_id);
+
+    std::vector<uint8_t> xbe(XBE_HEADERS_SIZE + (spec.title_image ? image.size() : 0), 0);
+    if (spec.title_image) {
+        memcpy(xbe.data() + XBE_HEADERS_SIZE, image.data(), image.size());
+    }
+
+    XBE_HEADER header;
+    memset(&header, 0, sizeof(header));
+    header.magic = 0x48454258;  // "XBEH"
+    header.base_address = XBE_BASE_ADDRESS;
+    header.size_of_headers = XBE_HEADERS_SIZE;
+    header.size_of_image = (uint32_t)xbe.size();
+    header.size_of_image_header = sizeof(XBE_HEADER);
+    header.certificate_address = XBE_BASE_ADDRESS + XBE_CERTIFICATE_OFFSET;
+    header.number_of_sections = spec.title_image ? 1 : 0;
+    header.section_headers_address = XBE_BASE_ADDRESS + XBE_SECTIONS_OFFSET;
+    header.logo_bitmap_address = XBE_BASE_ADDRESS + XBE_LOGO_OFFSET;
+    header.logo_bitmap_size = (uint32_t)logo.size();
+    memcpy(xbe.data(), &header, sizeof(header));
+
+    XBE_CERTIFICATE certificate;
+    memset(&certificate, 0, sizeof(certificate));
+    certificate.size = sizeof(certificate);
+    certificate.title_id = spec.title_id;
+    for (size_t i = 0; spec.name[i] && i < TITLE_LEN; i++) {
+        certificate.title_name[i] = (uint8_t)spec.name[i];
+    }
+    memcpy(xbe.data() + XBE_CERTIFICATE_OFFSET, &certificate, sizeof(certificate));
+
+    if (spec.title_image) {
+        static const char section_name[] = "$$XTIMAGE";
+        memcpy(xbe.data() + XBE_NAMES_OFFSET, section_name, sizeof(section_name));
+
+        XBE_SECTION section;
+        memset(&section, 0, sizeof(section));
+        section.raw_address = XBE_HEADERS_SIZE;
+        section.raw_size = (uint32_t)image.size();
+        section.virtual_size = section.raw_size;
+        section.section_name_address = XBE_BASE_ADDRESS + XBE_NAMES_OFFSET;
+
+        uint8_t size_le[4] = {
+            (uint8_t)section.raw_size,
+            (uint8_t)(section.raw_size >> 8),
+            (uint8_t)(section.raw_size >> 16),
+            (uint8_t)(section.raw_size >> 24)
+        };
+        SHA1 sha;
+        sha.Update(size_le, sizeof(size_le));
+        sha.Update(image.data(), image.size());
+        sha.Final(section.section_digest);
+        if (spec.no_digest) {
+            memset(section.section_digest, 0, sizeof(section.section_digest));
+        }
+        if (spec.bad_digest) {
+            section.section_digest[0] ^= 0xFF;
+        }
+        memcpy(xbe.data() + XBE_SECTIONS_OFFSET, &section, sizeof(section));
+    }
+
+    memcpy(xbe.data() + XBE_LOGO_OFFSET, logo.data(), logo.size());
+
+    expected.title_id = spec.title_id;
+    expected.title = spec.name;
+    if (spec.title_image) {
+        expected.title_image = image;
+    } else {
+        BuildXBXFromGrayscale(logo_pixels.data(), LOGO_WIDTH, LOGO_HEIGHT, expected.title_image);
+    }
+    return xbe;
+}
+
+// Writes one FATX volume into an image buffer
+class VolumeBuilder {
+public:
+    VolumeBuilder(std::vector<uint8_t>& image, uint64_t offset, uint64_t size, uint32_t cluster_size)
+        : image(image), offset(offset), cluster_size(cluster_size), next_cluster(2) {
+        // Same geometry rules as FatxVolume::Open
+        cluster_count = (uint32_t)(size / cluster_size) + 1;
+        fat16 = cluster_count < 0xFFF5;
+        uint64_t fat_size = (uint64_t)cluster_count * (fat16 ? 2 : 4);
+        fat_size = (fat_size + 0xFFF) & ~0xFFFULL;
+        data_offset = offset + 0x1000 + fat_size;
+
+        FATX_SUPERBLOCK superblock;
+        memset(&superblock, 0, sizeof(superblock));
+        superblock.magic = FATX_MAGIC;
+        superblock.volume_id = 0x1234;
+        superblock.sectors_per_cluster = cluster_size / XBOX_SECTOR_SIZE;
+        superblock.root_cluster = 1;
+        memcpy(&image[offset], &superblock, sizeof(superblock));
+
+        SetFat(0, EndOfChain());
+    }
+
+    bool IsFat16() const { return fat16; }
+
+    // Stores data in the next free clusters, or in the given ones
+    uint32_t Store(const std::vector<uint8_t>& data, std::vector<uint32_t> clusters = {}) {
+        size_t count = data.empty() ? 1 : (data.size() + cluster_size - 1) / cluster_size;
+        if (clusters.empty()) {
+            for (size_t i = 0; i < count; i++) {
+                clusters.push_back(next_cluster++);
+            }
+        }
+
+        for (size_t i = 0; i < clusters.size(); i++) {
+            SetFat(clusters[i], i + 1 < clusters.size() ? clusters[i + 1] : EndOfChain());
+
+            size_t chunk_offset = i * cluster_size;
+            if (chunk_offset < data.size()) {
+                size_t chunk = data.size() - chunk_offset;
+                if (chunk > cluster_size) chunk = cluster_size;
+                memcpy(&image[ClusterOffset(clusters[i])], data.data() + chunk_offset, chunk);
+            }
+        }
+        return clusters[0];
+    }
+
+    // Every other free cluster, so the file ends up in many runs
+    std::vector<uint32_t> Scattered(size_t size) {
+        std::vector<uint32_t> clusters;
+        size_t count = (size + cluster_size - 1) / cluster_size;
+        for (size_t i = 0; i < count; i++) {
+            clusters.push_back(next_cluster + (uint32_t)i * 2);
+        }
+        next_cluster += (uint32_t)count * 2;
+        return clusters;
+    }
+
+    std::vector<uint8_t> Dirent(const char* name, uint8_t attributes, uint32_t first_cluster, uint32_t size) {
+        FATX_DIRENT dirent;
+        memset(&dirent, 0, sizeof(dirent));
+        dirent.name_len = (uint8_t)strlen(name);
+        dirent.attributes = attributes;
+        memcpy(dirent.name, name, dirent.name_len);
+        dirent.first_cluster = first_cluster;
+        dirent.file_size = size;
+
+        const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&dirent);
+        return std::vector<uint8_t>(bytes, bytes + sizeof(dirent));
+    }
+
+    std::vector<uint8_t> Deleted(std::vector<uint8_t> dirent) {
+        dirent[0] = FATX_DIRENT_DELETED;
+        return dirent;
+    }
+
+    // Directory clusters end with unused (0xFF) entries
+    uint32_t StoreDirectory(const std::vector<std::vector<uint8_t>>& dirents, uint32_t cluster = 0) {
+        std::vector<uint8_t> data;
+        for (const auto& dirent : dirents) {
+            data.insert(data.end(), dirent.begin(), dirent.end());
+        }
+        data.resize(cluster_size, FATX_DIRENT_UNUSED);
+
+        std::vector<uint32_t> clusters;
+        if (cluster) clusters.push_back(cluster);
+        return Store(data, clusters);
+    }
+
+private:
+    std::vector<uint8_t>& image;
+    uint64_t offset;
+    uint32_t cluster_size;
+    uint32_t cluster_count;
+    bool fat16;
+    uint64_t data_offset;
+    uint32_t next_cluster;
+
+    uint32_t EndOfChain() const { return fat16 ? 0xFFFF : 0xFFFFFFFF; }
+
+    uint64_t ClusterOffset(uint32_t cluster) const {
+        return data_offset + (uint64_t)(cluster - 1) * cluster_size;
+    }
+
+    void SetFat(uint32_t cluster, uint32_t value) {
+        uint64_t entry = offset + 0x1000 + (uint64_t)cluster * (fat16 ? 2 : 4);
+        if (fat16) {
+            uint16_t value16 = (uint16_t)value;
+            memcpy(&image[entry], &value16, 2);
+        } else {
+            memcpy(&image[entry], &value, 4);
+        }
+    }
+};
+
+struct ImageCase {
+    const char* name;
+    uint64_t f_size;          // Nominal size of Partition6
+    uint32_t f_cluster_size;
+    uint64_t truncate_at;     // Image length, 0 for the full image
+};
+
+static const ImageCase IMAGE_CASES[] = {
+    {"fat16",     16 * MB, 0x4000, 0},
+    // Geometry must come from the table, not from what is left of the dump
+    {"truncated", 64 * MB, 0x4000, 24 * MB},
+    // 512 byte clusters push a 64 MB partition past the FAT16 cluster limit
+    {"fat32",     64 * MB, 0x200,  0},
+};
+
+#define E_OFFSET (1 * MB)
+#define E_SIZE (8 * MB)
+#define F_OFFSET (16 * MB)
+
+static bool WriteFile(const std::string& path, const std::vector<uint8_t>& data) {
+    FILE* f = fopen(path.c_str(), "wb");
+    if (!f) {
+        printf("Failed to create %s\n", path.c_str());
+        return false;
+    }
+    bool success = fwrite(data.data(), 1, data.size(), f) == data.size();
+    fclose(f);
+    return success;
+}
+
+static bool WriteFile(const std::string& path, const std::string& text) {
+    return WriteFile(path, std::vector<uint8_t>(text.begin(), text.end()));
+}
+
+// The E:\ tree fatx_scan writes for these titles, in scan order
+static bool WriteExpected(const std::string& root, const std::vector<ExpectedTitle>& titles) {
+    std::string udata = JoinPath(root, "UDATA");
+    MakeDirectory(root);
+    MakeDirectory(udata);
+
+    std::string icons = "[default]\n";
+    std::string names = "[default]\n";
+    std::map<std::string, const std::vector<uint8_t>*> files;
+    std::vector<std::vector<uint8_t>> metas;
+    metas.reserve(titles.size());
+    char id[16];
+
+    for (const auto& title : titles) {
+        snprintf(id, sizeof(id), "%08X", title.title_id);
+        icons += title.dir_name + "=" + id + "\n";
+        names += title.dir_name + "=" + title.title + "\n";
+
+        std::string meta = "TitleName=" + title.title + "\n";
+        metas.emplace_back(meta.begin(), meta.end());
+
+        std::string dir = JoinPath(udata, id);
+        MakeDirectory(dir);
+        if (!WriteFile(JoinPath(dir, "TitleImage.xbx"), title.title_image) ||
+            !WriteFile(JoinPath(dir, "TitleMeta.xbx"), metas.back())) {
+            return false;
+        }
+        files[std::string("UDATA\\") + id + "\\TitleImage.xbx"] = &title.title_image;
+        files[std::string("UDATA\\") + id + "\\TitleMeta.xbx"] = &metas.back();
+    }
+
+    // Digest cache, keyed relative to the output root
+    std::string cache;
+    char line[MAX_PATH + 32];
+    for (const auto& file : files) {
+        snprintf(line, sizeof(line), "%08lX %lu %s\n",
+                 (unsigned long)Crc32(*file.second), (unsigned long)file.second->size(),
+                 file.first.c_str());
+        cache += line;
+    }
+
+    return WriteFile(JoinPath(root, "Icons.ini"), icons) &&
+           WriteFile(JoinPath(root, "TitleNames.ini"), names) &&
+           WriteFile(JoinPath(udata, "iconator.crc"), cache);
+}
+
+static bool BuildCase(const std::string& dir, const ImageCase& test) {
+    std::vector<uint8_t> image(F_OFFSET + test.f_size, 0);
+    std::vector<ExpectedTitle> expected;
+
+    // Partition table with E: as Partition1 and F: as Partition6
+    XBOX_PARTITION_TABLE table;
+    memset(&table, 0, sizeof(table));
+    memcpy(table.magic, XBOX_PARTITION_MAGIC, sizeof(table.magic));
+    strcpy(table.entries[0].name, "XBOX SHELL");
+    table.entries[0].flags = XBOX_PARTITION_IN_USE;
+    table.entries[0].lba_start = E_OFFSET / XBOX_SECTOR_SIZE;
+    table.entries[0].lba_size = E_SIZE / XBOX_SECTOR_SIZE;
+    strcpy(table.entries[5].name, "XBOX F");
+    table.entries[5].flags = XBOX_PARTITION_IN_USE;
+    table.entries[5].lba_start = F_OFFSET / XBOX_SECTOR_SIZE;
+    table.entries[5].lba_size = (uint32_t)(test.f_size / XBOX_SECTOR_SIZE);
+    memcpy(image.data(), &table, sizeof(table));
+
+    // E:\Apps\Tool\default.xbe, scanned first
+    VolumeBuilder e(image, E_OFFSET, E_SIZE, 0x4000);
+    ExpectedTitle tool;
+    tool.dir_name = "Tool";
+    std::vector<uint8_t> toolXbe = BuildXBE({0x0000ABCD, "Tool", true, false, false}, tool);
+    uint32_t toolDir = e.StoreDirectory({ e.Dirent("default.xbe", 0, e.Store(toolXbe), (uint32_t)toolXbe.size()) });
+    uint32_t apps = e.StoreDirectory({ e.Dirent("Tool", FATX_ATTR_DIRECTORY, toolDir, 0) });
+    e.StoreDirectory({ e.Dirent("Apps", FATX_ATTR_DIRECTORY, apps, 0) }, 1);
+    expected.push_back(tool);
+
+    VolumeBuilder f(image, F_OFFSET, test.f_size, test.f_cluster_size);
+    if (f.IsFat16() != (test.f_cluster_size == 0x4000)) {
+        printf("%s: unexpected FAT width\n", test.name);
+        return false;
+    }
+
+    // F:\Games\Halo\default.xbe, spread over non-adjacent clusters
+    ExpectedTitle halo;
+    halo.dir_name = "Halo";
+    std::vector<uint8_t> haloXbe = BuildXBE({0x4D530004, "Halo", true, false, false}, halo);
+    uint32_t haloFirst = f.Store(haloXbe, f.Scattered(haloXbe.size()));
+    uint32_t readme = f.Store(std::vector<uint8_t>(100, 'x'));
+    uint32_t haloDir = f.StoreDirectory({
+        f.Dirent("readme.txt", 0, readme, 100),
+        f.Dirent("default.xbe", 0, haloFirst, (uint32_t)haloXbe.size()),
+    });
+
+    // F:\Games\NoImg\Default.XBE behind a deleted entry, falls back to the logo.
+    // The mixed case name is found through IsDefaultXBE, as on the console
+    ExpectedTitle noImg;
+    noImg.dir_name = "NoImg";
+    std::vector<uint8_t> noImgXbe = BuildXBE({0x12345678, "Logo Only", false, false, false}, noImg);
+    uint32_t noImgDir = f.StoreDirectory({
+        f.Deleted(f.Dirent("default.xbe", 0, readme, 100)),
+        f.Dirent("Default.XBE", 0, f.Store(noImgXbe), (uint32_t)noImgXbe.size()),
+    });
+
+    // F:\Games\Bad\default.xbe, title image digest does not match
+    ExpectedTitle bad;
+    std::vector<uint8_t> badXbe = BuildXBE({0x0BADBAD0, "Broken", true, true, false}, bad);
+    uint32_t badDir = f.StoreDirectory({
+        f.Dirent("default.xbe", 0, f.Store(badXbe), (uint32_t)badXbe.size()),
+    });
+
+    // F:\Games\Homebrew\default.xbe, title image without a digest
+    ExpectedTitle homebrew;
+    homebrew.dir_name = "Homebrew";
+    std::vector<uint8_t> homebrewXbe = BuildXBE({0x0000C0DE, "Homebrew", true, false, true}, homebrew);
+    uint32_t homebrewDir = f.StoreDirectory({
+        f.Dirent("default.xbe", 0, f.Store(homebrewXbe), (uint32_t)homebrewXbe.size()),
+    });
+
+    // F:\Games\Gone, a deleted title folder that must not be scanned
+    ExpectedTitle gone;
+    std::vector<uint8_t> goneXbe = BuildXBE({0xDE1E7ED0, "Deleted", true, false, false}, gone);
+    uint32_t goneDir = f.StoreDirectory({
+        f.Dirent("default.xbe", 0, f.Store(goneXbe), (uint32_t)goneXbe.size()),
+    });
+
+    uint32_t games = f.StoreDirectory({
+        f.Dirent("Halo", FATX_ATTR_DIRECTORY, haloDir, 0),
+        f.Deleted(f.Dirent("Gone", FATX_ATTR_DIRECTORY, goneDir, 0)),
+        f.Dirent("NoImg", FATX_ATTR_DIRECTORY, noImgDir, 0),
+        f.Dirent("Bad", FATX_ATTR_DIRECTORY, badDir, 0),
+        f.Dirent("Homebrew", FATX_ATTR_DIRECTORY, homebrewDir, 0),
+    });
+    f.StoreDirectory({ f.Dirent("Games", FATX_ATTR_DIRECTORY, games, 0) }, 1);
+    expected.push_back(halo);
+    expected.push_back(noImg);
+    expected.push_back(homebrew);
+
+    if (test.truncate_at) {
+        image.resize(test.truncate_at);
+    }
+
+    std::string expectedDir = JoinPath(dir, std::string(test.name) + ".expected");
+    MakeDirectory(expectedDir);
+    return WriteFile(JoinPath(dir, std::string(test.name) + ".img"), image) &&
+           WriteExpected(JoinPath(expectedDir, "E"), expected);
+}
+
+int main(int argc, char** argv) {
+    if (argc != 2) {
+        printf("Usage: %s <output dir>\n", argv[0]);
+        return 1;
+    }
+
+    MakeDirectory(argv[1]);
+    for (const auto& test : IMAGE_CASES) {
+        if (!BuildCase(argv[1], test)) {
+            return 2;
+        }
+        printf("%s\n", test.name);
+    }
+    return 0;
+}
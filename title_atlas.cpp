@@ -0,0 +1,153 @@
+#include "title_atlas.h"
+#include "xbx_image.h"
+#include <stdio.h>
+#include <string.h>
+#include <set>
+
+TitleAtlas::TitleAtlas() : slot_count(0) {
+}
+
+void TitleAtlas::LoadIndex(const std::string& index) {
+    previous_slots.clear();
+
+    size_t pos = 0;
+    while (pos < index.size()) {
+        size_t end = index.find('\n', pos);
+        if (end == std::string::npos) end = index.size();
+        std::string line = index.substr(pos, end - pos);
+        pos = end + 1;
+
+        // Pages=, TileSize= and the section header don't parse as a title ID
+        unsigned int title_id, page, x, y, width, height;
+        if (sscanf(line.c_str(), "%8X=%u,%u,%u,%u,%u", &title_id, &page, &x, &y, &width, &height) != 6 ||
+            x % XBX_IMAGE_SIZE || y % XBX_IMAGE_SIZE ||
+            x >= ATLAS_WIDTH || y >= ATLAS_TILES_PER_PAGE / ATLAS_TILES_PER_ROW * XBX_IMAGE_SIZE) {
+            continue;
+        }
+
+        previous_slots[title_id] = page * ATLAS_TILES_PER_PAGE +
+                                   y / XBX_IMAGE_SIZE * ATLAS_TILES_PER_ROW +
+                                   x / XBX_IMAGE_SIZE;
+    }
+}
+
+bool TitleAtlas::AddImage(uint32_t title_id, const std::vector<uint8_t>& xbx) {
+    // First image wins when several XBEs share a title ID
+    if (tiles.count(title_id)) {
+        return true;
+    }
+
+    std::vector<uint8_t> blocks;
+    if (!ConvertXBXToDXT1(xbx, blocks)) {
+        return false;
+    }
+
+    tiles[title_id].swap(blocks);
+    return true;
+}
+
+void TitleAtlas::AssignSlots() {
+    slots.clear();
+    slot_count = 0;
+
+    // Titles that are gone free their slot simply by not being in tiles
+    std::set<uint32_t> used;
+    for (const auto& tile : tiles) {
+        auto previous = previous_slots.find(tile.first);
+        if (previous != previous_slots.end() && used.insert(previous->second).second) {
+            slots[tile.first] = previous->second;
+        }
+    }
+
+    uint32_t next_free = 0;
+    for (const auto& tile : tiles) {
+        if (slots.count(tile.first)) continue;
+
+        while (used.count(next_free)) next_free++;
+        used.insert(next_free);
+        slots[tile.first] = next_free;
+    }
+
+    if (!used.empty()) {
+        slot_count = *used.rbegin() + 1;
+    }
+}
+
+size_t TitleAtlas::GetTileCount() const {
+    return slots.size();
+}
+
+size_t TitleAtlas::GetPageCount() const {
+    return (slot_count + ATLAS_TILES_PER_PAGE - 1) / ATLAS_TILES_PER_PAGE;
+}
+
+bool TitleAtlas::BuildPage(size_t page, std::vector<uint8_t>& xbx) const {
+    size_t first = page * ATLAS_TILES_PER_PAGE;
+    if (first >= slot_count) {
+        return false;
+    }
+
+    // The page is only as tall as its last used row, rounded to a power of two
+    uint32_t count = 1;
+    for (const auto& slot : slots) {
+        if (slot.second >= first && slot.second - first < ATLAS_TILES_PER_PAGE &&
+            slot.second - first >= count) {
+            count = slot.second - first + 1;
+        }
+    }
+
+    uint32_t rows = (count + ATLAS_TILES_PER_ROW - 1) / ATLAS_TILES_PER_ROW;
+    uint32_t log_width = 0, log_height = 0;
+    while ((1u << log_width) < ATLAS_WIDTH) log_width++;
+    while ((1u << log_height) < rows * XBX_IMAGE_SIZE) log_height++;
+
+    const uint32_t page_blocks_per_row = ATLAS_WIDTH / 4;
+    const uint32_t tile_blocks_per_row = XBX_IMAGE_SIZE / 4;
+    const uint32_t row_bytes = tile_blocks_per_row * DXT1_BLOCK_SIZE;
+
+    // Free slots stay zeroed, which decodes as black
+    BuildXBXHeader(XBX_FORMAT_DXT1, log_width, log_height,
+                   page_blocks_per_row * ((1u << log_height) / 4) * DXT1_BLOCK_SIZE, xbx);
+    uint8_t* texels = xbx.data() + XPR_HEADER_SIZE;
+
+    for (const auto& slot : slots) {
+        if (slot.second < first || slot.second - first >= ATLAS_TILES_PER_PAGE) continue;
+
+        uint32_t in_page = slot.second - first;
+        uint32_t tile_x = (in_page % ATLAS_TILES_PER_ROW) * tile_blocks_per_row;
+        uint32_t tile_y = (in_page / ATLAS_TILES_PER_ROW) * tile_blocks_per_row;
+        const std::vector<uint8_t>& blocks = tiles.at(slot.first);
+
+        // One block row of the tile is contiguous in both source and page
+        for (uint32_t by = 0; by < tile_blocks_per_row; by++) {
+            memcpy(texels + ((tile_y + by) * page_blocks_per_row + tile_x) * DXT1_BLOCK_SIZE,
+                   blocks.data() + by * row_bytes,
+                   row_bytes);
+        }
+    }
+
+    return true;
+}
+
+void TitleAtlas::BuildIndex(std::string& index) const {
+    char line[64];
+
+    index = "[default]\n";
+    snprintf(line, sizeof(line), "Pages=%u\nTileSize=%u\n",
+             (unsigned)GetPageCount(), (unsigned)XBX_IMAGE_SIZE);
+    index += line;
+
+    // <TitleID>=<page>,<x>,<y>,<width>,<height> in texels; the page height
+    // is in its XBX header, divide by it for normalized UVs
+    for (const auto& slot : slots) {
+        uint32_t in_page = slot.second % ATLAS_TILES_PER_PAGE;
+        snprintf(line, sizeof(line), "%08X=%u,%u,%u,%u,%u\n",
+                 slot.first,
+                 (unsigned)(slot.second / ATLAS_TILES_PER_PAGE),
+                 (unsigned)(in_page % ATLAS_TILES_PER_ROW * XBX_IMAGE_SIZE),
+                 (unsigned)(in_page / ATLAS_TILES_PER_ROW * XBX_IMAGE_SIZE),
+                 (unsigned)XBX_IMAGE_SIZE,
+                 (unsigned)XBX_IMAGE_SIZE);
+        index += line;
+    }
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+// Atlas pages are ATLAS_WIDTH texels wide and hold ATLAS_TILES_PER_PAGE
+// XBX_IMAGE_SIZE square title images as DXT1
+#define ATLAS_WIDTH 1024
+#define ATLAS_TILES_PER_ROW 8
+#define ATLAS_TILES_PER_PAGE 64
+
+// Packs title images into a few large DXT1 textures plus a title ID to
+// texel rectangle index, so a dashboard can load all icons in a handful of reads
+class TitleAtlas {
+public:
+    TitleAtlas();
+
+    // Remembers the placement from a previous index, so titles keep their
+    // rectangle across runs and unchanged pages compare equal
+    void LoadIndex(const std::string& index);
+    bool AddImage(uint32_t title_id, const std::vector<uint8_t>& xbx);
+
+    // Call once all images are added: titles keep their previous slot, new
+    // ones take the lowest free slots in title ID order
+    void AssignSlots();
+
+    size_t GetTileCount() const;
+    size_t GetPageCount() const;
+    bool BuildPage(size_t page, std::vector<uint8_t>& xbx) const;
+    void BuildIndex(std::string& index) const;
+
+private:
+    // DXT1 blocks per title
+    std::map<uint32_t, std::vector<uint8_t>> tiles;
+
+    // Title ID to slot, page * ATLAS_TILES_PER_PAGE + row * ATLAS_TILES_PER_ROW + column
+    std::map<uint32_t, uint32_t> previous_slots;
+    std::map<uint32_t, uint32_t> slots;
+    uint32_t slot_count;
+};
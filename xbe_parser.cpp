@@ -1,66 +1,123 @@
 #include "xbe_parser.h"
+#include "sha1.h"
 #include <fstream>
 #include <sstream>
 #include <string>
 #include <iomanip>
 #include <string.h>
 
-XBEParser::XBEParser() : xbe_data(nullptr), xbe_size(0) {}
+// Sections are hashed through a buffer of this size, never loaded whole
+#define XBE_HASH_CHUNK_SIZE 0x10000
 
-XBEParser::~XBEParser() {
-    if (xbe_data) {
-        delete[] xbe_data;
-    }
-}
+#ifndef NXDK
+#include <atomic>
+#include <mutex>
+#include <thread>
+
+// Section hashing is spread over this many threads at most
+#define VERIFY_MAX_THREADS 8
+#endif
+
+XBEParser::XBEParser() : xbe_size(0) {}
+
+XBEParser::~XBEParser() {}
 
 bool XBEParser::LoadXBE(const std::string& filepath) {
-    std::ifstream file(filepath, std::ios::binary | std::ios::ate);
+    if (file.is_open()) {
+        file.close();
+    }
+
+    file.open(filepath, std::ios::binary | std::ios::ate);
     if (!file.is_open()) {
         return false;
     }
 
-    xbe_size = file.tellg();
-    file.seekg(0, std::ios::beg);
+    uint64_t size = file.tellg();
+    return LoadXBE(size, [this](uint64_t offset, void* dst, size_t len) {
+        file.clear();
+        file.seekg(offset, std::ios::beg);
+        return (bool)file.read(reinterpret_cast<char*>(dst), len);
+    });
+}
 
-    xbe_data = new uint8_t[xbe_size];
-    if (!file.read(reinterpret_cast<char*>(xbe_data), xbe_size)) {
-        delete[] xbe_data;
-        xbe_data = nullptr;
-        return false;
-    }
+// For XBEs that are not reachable through the filesystem, e.g. inside a disk image
+bool XBEParser::LoadXBE(uint64_t size, const XBEReader& reader) {
+    headers.clear();
+    sections.clear();
+    xbe_size = size;
+    read = reader;
 
     return ReadXBE();
 }
 
 bool XBEParser::ReadXBE() {
-    if (!xbe_data || xbe_size < sizeof(XBE_HEADER)) {
+    if (xbe_size < sizeof(XBE_HEADER) || !read(0, &header, sizeof(XBE_HEADER))) {
         return false;
     }
 
-    memcpy(&header, xbe_data, sizeof(XBE_HEADER));
-
     // Verify XBE magic number
     if (header.magic != 0x48454258) { // "XBEH"
         return false;
     }
 
-    return ReadCertificate() && ReadSections();
+    // Certificate, section headers, section names and logo all live in here
+    if (header.size_of_headers < sizeof(XBE_HEADER) || header.size_of_headers > xbe_size ||
+        header.size_of_headers > XBE_MAX_HEADERS_SIZE) {
+        return false;
+    }
+
+    headers.resize(header.size_of_headers);
+    if (!read(0, headers.data(), headers.size())) {
+        headers.clear();
+        return false;
+    }
+
+    if (!ReadCertificate() || !ReadSections()) {
+        headers.clear();
+        return false;
+    }
+    return true;
+}
+
+// Header fields hold virtual addresses; the headers are mapped at base_address
+bool XBEParser::HeaderOffset(uint32_t address, size_t length, uint32_t& offset) const {
+    if (address < header.base_address) {
+        return false;
+    }
+
+    offset = address - header.base_address;
+    return offset <= headers.size() && length <= headers.size() - offset;
+}
+
+bool XBEParser::ReadSection(const XBE_SECTION& section, std::vector<uint8_t>& data) {
+    if (section.raw_address > xbe_size || section.raw_size > xbe_size - section.raw_address) {
+        return false;
+    }
+
+    data.resize(section.raw_size);
+    if (!read(section.raw_address, data.data(), data.size())) {
+        data.clear();
+        return false;
+    }
+    return true;
 }
 
 bool XBEParser::ReadCertificate() {
-    if (!xbe_data || header.certificate_address >= xbe_size) {
+    uint32_t offset;
+    if (!HeaderOffset(header.certificate_address, sizeof(XBE_CERTIFICATE), offset)) {
         return false;
     }
 
     memcpy(&certificate, 
-           xbe_data + header.certificate_address, 
+           headers.data() + offset, 
            sizeof(XBE_CERTIFICATE));
 
     return true;
 }
 
 bool XBEParser::ReadSections() {
-    if (!xbe_data || header.section_headers_address >= xbe_size) {
+    uint32_t headers_offset;
+    if (!HeaderOffset(header.section_headers_address, 0, headers_offset)) {
         return false;
     }
 
@@ -70,13 +127,13 @@ bool XBEParser::ReadSections() {
     // Read each section header
     for (uint32_t i = 0; i < header.number_of_sections; i++) {
         XBE_SECTION section;
-        uint32_t section_offset = header.section_headers_address + (i * sizeof(XBE_SECTION));
+        size_t section_offset = headers_offset + (i * sizeof(XBE_SECTION));
         
-        if (section_offset + sizeof(XBE_SECTION) > xbe_size) {
+        if (section_offset + sizeof(XBE_SECTION) > headers.size()) {
             return false;
         }
 
-        memcpy(&section, xbe_data + section_offset, sizeof(XBE_SECTION));
+        memcpy(&section, headers.data() + section_offset, sizeof(XBE_SECTION));
         sections.push_back(section);
     }
 
@@ -85,17 +142,16 @@ bool XBEParser::ReadSections() {
 
 bool XBEParser::GetSectionByName(const std::string& name, XBE_SECTION& section) {
     for (const auto& sec : sections) {
-        // Section name is stored as an offset from base address
-        if (sec.section_name_address >= xbe_size) {
+        // Section name is stored as a virtual address
+        uint32_t name_offset;
+        if (!HeaderOffset(sec.section_name_address, 0, name_offset)) {
             continue;
         }
 
         std::string section_name;
-        const char* name_ptr = reinterpret_cast<const char*>(xbe_data + sec.section_name_address);
-        
-        // Read until null terminator or end of file
-        while (*name_ptr && (reinterpret_cast<const uint8_t*>(name_ptr) - xbe_data) < xbe_size) {
-            section_name += *name_ptr++;
+        // Read until null terminator or end of the headers
+        for (size_t i = name_offset; i < headers.size() && headers[i]; i++) {
+            section_name += static_cast<char>(headers[i]);
         }
 
         if (section_name == name) {
@@ -107,7 +163,7 @@ bool XBEParser::GetSectionByName(const std::string& name, XBE_SECTION& section)
 }
 
 bool XBEParser::ExtractTitleID(uint32_t& title_id) {
-    if (!xbe_data) {
+    if (headers.empty()) {
         return false;
     }
     
@@ -116,7 +172,7 @@ bool XBEParser::ExtractTitleID(uint32_t& title_id) {
 }
 
 bool XBEParser::ExtractTitle(std::string& title) {
-    if (!xbe_data) {
+    if (headers.empty()) {
         return false;
     }
 
@@ -129,7 +185,7 @@ bool XBEParser::ExtractTitle(std::string& title) {
 }
 
 bool XBEParser::ExtractTitleImage(std::vector<uint8_t>& image_data) {
-    if (!xbe_data) {
+    if (headers.empty()) {
         return false;
     }
 
@@ -139,11 +195,236 @@ bool XBEParser::ExtractTitleImage(std::vector<uint8_t>& image_data) {
         return false;
     }
 
-    const uint8_t *xtimage_data = xbe_data + section.raw_address;
-
     // Copy the entire bitmap data
-    image_data.resize(section.raw_size);
-    memcpy(image_data.data(), xtimage_data, section.raw_size);
+    return ReadSection(section, image_data);
+}
 
+bool XBEParser::ExtractLogoBitmap(uint8_t* pixels, size_t pixels_size) {
+    if (headers.empty() || pixels_size < LOGO_WIDTH * LOGO_HEIGHT) {
+        return false;
+    }
+
+    // The logo lives in the headers
+    uint32_t offset;
+    if (header.logo_bitmap_size == 0 ||
+        !HeaderOffset(header.logo_bitmap_address, header.logo_bitmap_size, offset)) {
+        return false;
+    }
+
+    const uint8_t* rle = headers.data() + offset;
+    const uint8_t* rle_end = rle + header.logo_bitmap_size;
+    uint8_t* out = pixels;
+    uint8_t* out_end = pixels + LOGO_WIDTH * LOGO_HEIGHT;
+
+    while (rle < rle_end && out < out_end) {
+        uint32_t len;
+        uint32_t value;
+
+        if (rle[0] & 1) {
+            // 8-bit run: bit 0 set, 3-bit length, 4-bit value
+            len = (rle[0] >> 1) & 0x7;
+            value = rle[0] >> 4;
+            rle += 1;
+        } else if (rle[0] & 2) {
+            // 16-bit run: bit 1 set, 10-bit length, 4-bit value. One cut off
+            // by the end of the stream leaves the rest of the logo black
+            if (rle + 1 >= rle_end) {
+                break;
+            }
+            uint16_t word = rle[0] | (rle[1] << 8);
+            len = (word >> 2) & 0x3FF;
+            value = word >> 12;
+            rle += 2;
+        } else {
+            // Neither run bit set, treat it as a zero-length run and move on
+            rle += 1;
+            continue;
+        }
+
+        if (len > (uint32_t)(out_end - out)) {
+            len = out_end - out;
+        }
+
+        // Expand the 4-bit intensity to the full 8-bit range
+        memset(out, (value << 4) | value, len);
+        out += len;
+    }
+
+    // Anything the stream did not cover stays black
+    memset(out, 0, out_end - out);
     return true;
-} 
\ No newline at end of file
+}
+
+// The digest covers the raw size (little-endian) followed by the raw data
+static void HashSizePrefix(SHA1& sha, uint32_t raw_size) {
+    uint8_t size_le[4] = {
+        (uint8_t)raw_size,
+        (uint8_t)(raw_size >> 8),
+        (uint8_t)(raw_size >> 16),
+        (uint8_t)(raw_size >> 24)
+    };
+    sha.Update(size_le, sizeof(size_le));
+}
+
+// For a section that is already in memory, e.g. the title image
+static bool DigestMatches(const XBE_SECTION& section, const std::vector<uint8_t>& data) {
+    uint8_t digest[DIGEST_LEN];
+    SHA1 sha;
+    HashSizePrefix(sha, section.raw_size);
+    sha.Update(data.data(), data.size());
+    sha.Final(digest);
+    return memcmp(digest, section.section_digest, DIGEST_LEN) == 0;
+}
+
+// Homebrew built without signing leaves the digest zeroed; there is nothing
+// to compare against, which is not the same as a corrupt section
+static bool DigestIsSet(const XBE_SECTION& section) {
+    for (size_t i = 0; i < DIGEST_LEN; i++) {
+        if (section.section_digest[i]) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Reads go through reader in XBE_HASH_CHUNK_SIZE pieces into buffer, so a
+// multi-MB section costs no more memory than a small one
+bool XBEParser::HashSection(const XBE_SECTION& section, const XBEReader& reader,
+                            std::vector<uint8_t>& buffer, uint8_t digest[DIGEST_LEN]) const {
+    if (section.raw_address > xbe_size || section.raw_size > xbe_size - section.raw_address) {
+        return false;
+    }
+
+    SHA1 sha;
+    HashSizePrefix(sha, section.raw_size);
+
+    buffer.resize(XBE_HASH_CHUNK_SIZE);
+    uint64_t offset = section.raw_address;
+    uint32_t remaining = section.raw_size;
+    while (remaining) {
+        size_t chunk = remaining < XBE_HASH_CHUNK_SIZE ? remaining : XBE_HASH_CHUNK_SIZE;
+        if (!reader(offset, buffer.data(), chunk)) {
+            return false;
+        }
+        sha.Update(buffer.data(), chunk);
+        offset += chunk;
+        remaining -= chunk;
+    }
+
+    sha.Final(digest);
+    return true;
+}
+
+bool XBEParser::VerifySectionDigest(const XBE_SECTION& section) {
+    if (headers.empty()) {
+        return false;
+    }
+
+    std::vector<uint8_t> buffer;
+    uint8_t digest[DIGEST_LEN];
+    return HashSection(section, read, buffer, digest) &&
+           memcmp(digest, section.section_digest, DIGEST_LEN) == 0;
+}
+
+XBEVerifyResult XBEParser::VerifySections(bool all_sections, size_t& bytes_hashed,
+                                          std::vector<uint8_t>& title_image) {
+    bytes_hashed = 0;
+    title_image.clear();
+
+    if (headers.empty()) {
+        return XBE_VERIFY_NO_SECTION;
+    }
+
+    if (!all_sections) {
+        XBE_SECTION section = {0};
+
+        // A missing title image is not a verified one
+        if (!GetSectionByName("$$XTIMAGE", section) || !DigestIsSet(section)) {
+            return XBE_VERIFY_NO_SECTION;
+        }
+
+        // The image is needed anyway, so it is read whole and checked in place
+        // rather than streamed through the hash and then read a second time
+        bytes_hashed = section.raw_size;
+        if (!ReadSection(section, title_image) || !DigestMatches(section, title_image)) {
+            title_image.clear();
+            return XBE_VERIFY_MISMATCH;
+        }
+
+        return XBE_VERIFY_OK;
+    }
+
+    if (sections.empty()) {
+        return XBE_VERIFY_NO_SECTION;
+    }
+
+#ifndef NXDK
+    // The reader is not thread safe, so reads stay serialized chunk by chunk
+    // and only the hashing runs in parallel
+    size_t thread_count = std::thread::hardware_concurrency();
+    if (thread_count > VERIFY_MAX_THREADS) thread_count = VERIFY_MAX_THREADS;
+    if (thread_count > sections.size()) thread_count = sections.size();
+    if (thread_count < 1) thread_count = 1;
+
+    std::atomic<size_t> next(0);
+    std::atomic<size_t> hashed(0);
+    std::atomic<bool> mismatch(false);
+    std::atomic<bool> unset(false);
+    std::mutex read_lock;
+    XBEReader locked_read = [&](uint64_t offset, void* dst, size_t len) {
+        std::lock_guard<std::mutex> lock(read_lock);
+        return read(offset, dst, len);
+    };
+
+    auto worker = [&]() {
+        std::vector<uint8_t> buffer;
+        uint8_t digest[DIGEST_LEN];
+        size_t i;
+        while (!mismatch && (i = next++) < sections.size()) {
+            if (!DigestIsSet(sections[i])) {
+                unset = true;
+                continue;
+            }
+
+            hashed += sections[i].raw_size;
+            if (!HashSection(sections[i], locked_read, buffer, digest) ||
+                memcmp(digest, sections[i].section_digest, DIGEST_LEN) != 0) {
+                mismatch = true;
+            }
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (size_t t = 1; t < thread_count; t++) {
+        workers.emplace_back(worker);
+    }
+    worker();
+    for (auto& t : workers) {
+        t.join();
+    }
+
+    bytes_hashed = hashed;
+    if (mismatch) {
+        return XBE_VERIFY_MISMATCH;
+    }
+    return unset ? XBE_VERIFY_NO_SECTION : XBE_VERIFY_OK;
+#else
+    std::vector<uint8_t> buffer;
+    uint8_t digest[DIGEST_LEN];
+    bool unset = false;
+    for (const auto& sec : sections) {
+        if (!DigestIsSet(sec)) {
+            unset = true;
+            continue;
+        }
+
+        bytes_hashed += sec.raw_size;
+        if (!HashSection(sec, read, buffer, digest) ||
+            memcmp(digest, sec.section_digest, DIGEST_LEN) != 0) {
+            return XBE_VERIFY_MISMATCH;
+        }
+    }
+
+    return unset ? XBE_VERIFY_NO_SECTION : XBE_VERIFY_OK;
+#endif
+}
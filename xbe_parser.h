@@ -1,6 +1,8 @@
 #pragma once
 
 #include <cstdint>
+#include <fstream>
+#include <functional>
 #include <string>
 #include <vector>
 
@@ -9,6 +11,13 @@
 #define SIGNATURE_LEN 256
 #define KEY_LEN 16
 
+// Real XBEs have a few KB of headers; bounds the allocation for damaged files
+#define XBE_MAX_HEADERS_SIZE 0x100000
+
+// Publisher logo shown by the kernel at boot, 4-bit grayscale
+#define LOGO_WIDTH 100
+#define LOGO_HEIGHT 17
+
 // XBE header structures
 #pragma pack(push, 1)
 struct XBE_HEADER {
@@ -78,32 +87,55 @@ struct XBE_SECTION {
 };
 #pragma pack(pop)
 
+enum XBEVerifyResult {
+    XBE_VERIFY_OK,
+    XBE_VERIFY_MISMATCH,
+    XBE_VERIFY_NO_SECTION  // Nothing to verify, e.g. no $$XTIMAGE or a zeroed digest
+};
+
 struct GameInfo {
     std::string xbe_path;
     uint32_t title_id;
     std::string title;
     std::vector<uint8_t> title_image;  // Raw title image data (xbx)
+    std::vector<uint8_t> logo_bitmap;  // LOGO_WIDTH x LOGO_HEIGHT grayscale, fallback when there is no title image
 };
 
+// Reads len bytes at offset into dst, false on a short or failed read
+typedef std::function<bool(uint64_t offset, void* dst, size_t len)> XBEReader;
+
+// Only the headers are kept in memory, sections are read on demand
 class XBEParser {
 public:
     XBEParser();
     ~XBEParser();
 
     bool LoadXBE(const std::string& filepath);
+    bool LoadXBE(uint64_t size, const XBEReader& reader);
     bool ExtractTitleID(uint32_t& title_id);
     bool ExtractTitle(std::string& title);
     bool ExtractTitleImage(std::vector<uint8_t>& image_data);
+    bool ExtractLogoBitmap(uint8_t* pixels, size_t pixels_size);
     bool GetSectionByName(const std::string& name, XBE_SECTION& section);
+    bool VerifySectionDigest(const XBE_SECTION& section);
+    // With all_sections false, title_image receives the verified $$XTIMAGE
+    XBEVerifyResult VerifySections(bool all_sections, size_t& bytes_hashed,
+                                   std::vector<uint8_t>& title_image);
 
 private:
     XBE_HEADER header;
     XBE_CERTIFICATE certificate;
-    uint8_t* xbe_data;
-    size_t xbe_size;
+    std::vector<uint8_t> headers;  // size_of_headers bytes from the start of the file
+    uint64_t xbe_size;
+    std::ifstream file;            // Backs read for XBEs loaded by path
+    XBEReader read;
     std::vector<XBE_SECTION> sections;
 
+    bool HeaderOffset(uint32_t address, size_t length, uint32_t& offset) const;
+    bool ReadSection(const XBE_SECTION& section, std::vector<uint8_t>& data);
+    bool HashSection(const XBE_SECTION& section, const XBEReader& reader,
+                     std::vector<uint8_t>& buffer, uint8_t digest[DIGEST_LEN]) const;
     bool ReadXBE();
     bool ReadCertificate();
     bool ReadSections();
-}; 
\ No newline at end of file
+};
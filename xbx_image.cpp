@@ -0,0 +1,222 @@
+#include "xbx_image.h"
+#include <string.h>
+
+#define D3DCOMMON_TYPE_TEXTURE 0x00040000
+#define XBX_DMA_CHANNEL_A 1
+#define XBX_DIMENSION_2D 2
+
+// Interleaves x and y bits (x in the even bits), the Xbox texture swizzle
+// for square power of two textures
+static uint32_t Swizzle(uint32_t x, uint32_t y) {
+    uint32_t offset = 0;
+    for (uint32_t bit = 0; (1u << bit) < XBX_IMAGE_SIZE; bit++) {
+        offset |= ((x >> bit) & 1) << (bit * 2);
+        offset |= ((y >> bit) & 1) << (bit * 2 + 1);
+    }
+    return offset;
+}
+
+static uint32_t Log2(uint32_t value) {
+    uint32_t log = 0;
+    while ((1u << log) < value) {
+        log++;
+    }
+    return log;
+}
+
+void BuildXBXHeader(uint32_t format, uint32_t log_width, uint32_t log_height,
+                    uint32_t data_size, std::vector<uint8_t>& xbx) {
+    // Header padding is 0xAD, as written by the XDK bundler
+    xbx.assign(XPR_HEADER_SIZE, 0xAD);
+    xbx.resize(XPR_HEADER_SIZE + data_size, 0);
+
+    XPR_HEADER header;
+    header.magic = XPR_MAGIC;
+    header.total_size = XPR_HEADER_SIZE + data_size;
+    header.header_size = XPR_HEADER_SIZE;
+    memcpy(xbx.data(), &header, sizeof(header));
+
+    XBX_TEXTURE texture;
+    texture.common = D3DCOMMON_TYPE_TEXTURE | 1;
+    texture.data = 0;
+    texture.lock = 0;
+    texture.format = XBX_DMA_CHANNEL_A |
+                     (XBX_DIMENSION_2D << 4) |
+                     (format << 8) |
+                     (1 << 16) |              // Mip levels
+                     (log_width << 20) |
+                     (log_height << 24);
+    texture.size = 0;
+    memcpy(xbx.data() + sizeof(header), &texture, sizeof(texture));
+
+    // Resource list terminator
+    uint32_t end_marker = 0xFFFFFFFF;
+    memcpy(xbx.data() + sizeof(header) + sizeof(texture), &end_marker, sizeof(end_marker));
+}
+
+bool ParseXBX(const std::vector<uint8_t>& xbx, XBX_TEXTURE& texture, size_t& data_offset) {
+    if (xbx.size() < sizeof(XPR_HEADER) + sizeof(XBX_TEXTURE)) {
+        return false;
+    }
+
+    XPR_HEADER header;
+    memcpy(&header, xbx.data(), sizeof(header));
+    if (header.magic != XPR_MAGIC || header.header_size > xbx.size()) {
+        return false;
+    }
+
+    memcpy(&texture, xbx.data() + sizeof(header), sizeof(texture));
+    if ((texture.common & D3DCOMMON_TYPE_TEXTURE) == 0) {
+        return false;
+    }
+
+    data_offset = header.header_size + texture.data;
+    return data_offset <= xbx.size();
+}
+
+// Packs 8-bit channels into RGB565
+static uint16_t PackRGB565(const uint8_t* bgra) {
+    return (uint16_t)(((bgra[2] >> 3) << 11) | ((bgra[1] >> 2) << 5) | (bgra[0] >> 3));
+}
+
+static void UnpackRGB565(uint16_t color, int rgb[3]) {
+    rgb[0] = ((color >> 11) & 0x1F) * 255 / 31;
+    rgb[1] = ((color >> 5) & 0x3F) * 255 / 63;
+    rgb[2] = (color & 0x1F) * 255 / 31;
+}
+
+// Range fit between the darkest and brightest texel, good enough for icons
+static void EncodeDXT1Block(const uint8_t bgra[16][4], uint8_t* out) {
+    int min_index = 0, max_index = 0;
+    int min_luma = 0x7FFFFFFF, max_luma = -1;
+    for (int i = 0; i < 16; i++) {
+        int luma = bgra[i][2] * 2 + bgra[i][1] * 4 + bgra[i][0];
+        if (luma < min_luma) { min_luma = luma; min_index = i; }
+        if (luma > max_luma) { max_luma = luma; max_index = i; }
+    }
+
+    uint16_t color0 = PackRGB565(bgra[max_index]);
+    uint16_t color1 = PackRGB565(bgra[min_index]);
+    uint32_t indices = 0;
+
+    // color0 > color1 selects the four color mode
+    if (color0 < color1) {
+        uint16_t t = color0; color0 = color1; color1 = t;
+    }
+
+    if (color0 != color1) {
+        int palette[4][3];
+        UnpackRGB565(color0, palette[0]);
+        UnpackRGB565(color1, palette[1]);
+        for (int c = 0; c < 3; c++) {
+            palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+            palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+        }
+
+        for (int i = 0; i < 16; i++) {
+            int best = 0, best_dist = 0x7FFFFFFF;
+            for (int p = 0; p < 4; p++) {
+                int dr = bgra[i][2] - palette[p][0];
+                int dg = bgra[i][1] - palette[p][1];
+                int db = bgra[i][0] - palette[p][2];
+                int dist = dr * dr + dg * dg + db * db;
+                if (dist < best_dist) { best_dist = dist; best = p; }
+            }
+            indices |= (uint32_t)best << (i * 2);
+        }
+    }
+
+    out[0] = (uint8_t)color0;
+    out[1] = (uint8_t)(color0 >> 8);
+    out[2] = (uint8_t)color1;
+    out[3] = (uint8_t)(color1 >> 8);
+    out[4] = (uint8_t)indices;
+    out[5] = (uint8_t)(indices >> 8);
+    out[6] = (uint8_t)(indices >> 16);
+    out[7] = (uint8_t)(indices >> 24);
+}
+
+bool ConvertXBXToDXT1(const std::vector<uint8_t>& xbx, std::vector<uint8_t>& blocks) {
+    XBX_TEXTURE texture;
+    size_t data_offset;
+    if (!ParseXBX(xbx, texture, data_offset)) {
+        return false;
+    }
+
+    uint32_t format = (texture.format >> 8) & 0xFF;
+    uint32_t log_width = (texture.format >> 20) & 0xF;
+    uint32_t log_height = (texture.format >> 24) & 0xF;
+    uint32_t log_size = Log2(XBX_IMAGE_SIZE);
+    if (log_width != log_size || log_height != log_size) {
+        return false;
+    }
+
+    const uint32_t blocks_per_row = XBX_IMAGE_SIZE / 4;
+    const size_t dxt1_size = blocks_per_row * blocks_per_row * DXT1_BLOCK_SIZE;
+    const uint8_t* texels = xbx.data() + data_offset;
+    size_t texel_size = xbx.size() - data_offset;
+
+    if (format == XBX_FORMAT_DXT1) {
+        // Compressed textures are not swizzled, the blocks copy straight over
+        if (texel_size < dxt1_size) {
+            return false;
+        }
+        blocks.assign(texels, texels + dxt1_size);
+        return true;
+    }
+
+    if (format != XBX_FORMAT_A8R8G8B8 || texel_size < XBX_IMAGE_SIZE * XBX_IMAGE_SIZE * 4) {
+        return false;
+    }
+
+    blocks.resize(dxt1_size);
+    for (uint32_t by = 0; by < blocks_per_row; by++) {
+        for (uint32_t bx = 0; bx < blocks_per_row; bx++) {
+            uint8_t bgra[16][4];
+            for (uint32_t i = 0; i < 16; i++) {
+                memcpy(bgra[i], texels + Swizzle(bx * 4 + i % 4, by * 4 + i / 4) * 4, 4);
+            }
+            EncodeDXT1Block(bgra, blocks.data() + (by * blocks_per_row + bx) * DXT1_BLOCK_SIZE);
+        }
+    }
+
+    return true;
+}
+
+bool BuildXBXFromGrayscale(const uint8_t* pixels, uint32_t width, uint32_t height,
+                           std::vector<uint8_t>& xbx) {
+    if (!pixels || width > XBX_IMAGE_SIZE || height > XBX_IMAGE_SIZE) {
+        return false;
+    }
+
+    const uint32_t blocks_per_row = XBX_IMAGE_SIZE / 4;
+    uint32_t log_size = Log2(XBX_IMAGE_SIZE);
+    BuildXBXHeader(XBX_FORMAT_DXT1, log_size, log_size,
+                   blocks_per_row * blocks_per_row * DXT1_BLOCK_SIZE, xbx);
+
+    uint8_t* blocks = xbx.data() + XPR_HEADER_SIZE;
+    uint32_t left = (XBX_IMAGE_SIZE - width) / 2;
+    uint32_t top = (XBX_IMAGE_SIZE - height) / 2;
+
+    for (uint32_t by = 0; by < blocks_per_row; by++) {
+        for (uint32_t bx = 0; bx < blocks_per_row; bx++) {
+            uint8_t bgra[16][4];
+            for (uint32_t i = 0; i < 16; i++) {
+                uint32_t x = bx * 4 + i % 4;
+                uint32_t y = by * 4 + i / 4;
+                uint8_t gray = 0;
+                if (x >= left && x < left + width && y >= top && y < top + height) {
+                    gray = pixels[(y - top) * width + (x - left)];
+                }
+
+                bgra[i][0] = gray;
+                bgra[i][1] = gray;
+                bgra[i][2] = gray;
+                bgra[i][3] = 0xFF;
+            }
+            EncodeDXT1Block(bgra, blocks + (by * blocks_per_row + bx) * DXT1_BLOCK_SIZE);
+        }
+    }
+
+    return true;
+}
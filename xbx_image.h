@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// XPR0 container as used by .xbx dashboard images
+#define XPR_MAGIC 0x30525058   // "XPR0"
+#define XPR_HEADER_SIZE 0x800  // Header and resource descriptors, padded
+
+// Xbox D3D texture formats used here
+#define XBX_FORMAT_A8R8G8B8 0x06  // Swizzled
+#define XBX_FORMAT_DXT1 0x0C
+
+// Side length of generated (square, power of two) images
+#define XBX_IMAGE_SIZE 128
+
+// DXT1 stores 4x4 texel blocks in 8 bytes
+#define DXT1_BLOCK_SIZE 8
+
+#pragma pack(push, 1)
+struct XPR_HEADER {
+    uint32_t magic;        // "XPR0"
+    uint32_t total_size;   // Header plus texture data
+    uint32_t header_size;  // Offset of the texture data
+};
+
+struct XBX_TEXTURE {
+    uint32_t common;  // Reference count and resource type
+    uint32_t data;    // Offset of the texels, relative to the texture data
+    uint32_t lock;
+    uint32_t format;  // DMA channel, dimensions, format, mip levels, log2 sizes
+    uint32_t size;    // Only used by linear formats
+};
+#pragma pack(pop)
+
+// Writes the XPR header and texture descriptor for a single 2D texture of
+// 2^log_width x 2^log_height texels, leaving data_size zeroed bytes for the texels
+void BuildXBXHeader(uint32_t format, uint32_t log_width, uint32_t log_height,
+                    uint32_t data_size, std::vector<uint8_t>& xbx);
+
+// Locates the first texture in an XBX and validates its texel data bounds
+bool ParseXBX(const std::vector<uint8_t>& xbx, XBX_TEXTURE& texture, size_t& data_offset);
+
+// Re-encodes a XBX_IMAGE_SIZE square DXT1 or swizzled A8R8G8B8 XBX as
+// row-major DXT1 blocks
+bool ConvertXBXToDXT1(const std::vector<uint8_t>& xbx, std::vector<uint8_t>& blocks);
+
+// Centers an 8-bit grayscale bitmap on an opaque black square and encodes it
+// as a DXT1 XBX.
+bool BuildXBXFromGrayscale(const uint8_t* pixels, uint32_t width, uint32_t height,
+                           std::vector<uint8_t>& xbx);